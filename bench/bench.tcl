@@ -0,0 +1,209 @@
+# Throughput and latency of the ::ksuid:: commands as seen from Tcl.
+#
+# Usage: tclsh8.6 bench/bench.tcl libdir ?-iterations n? ?-threads n?
+#            ?-sort-count n? ?-min-sort-speedup x?
+#
+# Every command is timed in batches of 100 calls, per-call latencies are
+# derived from the batches. With -threads n the same benchmark runs in n Tcl
+# threads at once (requires the Thread package) and the results are merged.
+# ::ksuid::sort is compared with lsort on a shuffled list of -sort-count
+# fresh strings; with -min-sort-speedup the script fails when the ratio is
+# below x. The results are printed to stdout as JSON.
+
+if { [llength $argv] == 0 } {
+    puts stderr "Usage: $argv0 libdir ?-iterations n? ?-threads n? ?-sort-count n? ?-min-sort-speedup x?"
+    exit 1
+}
+
+set libdir [file normalize [lindex $argv 0]]
+set options [dict merge {-iterations 200 -threads 1 -sort-count 200000 -min-sort-speedup 0} [lrange $argv 1 end]]
+set iterations [dict get $options -iterations]
+set threads [dict get $options -threads]
+set sort_count [dict get $options -sort-count]
+set min_sort_speedup [dict get $options -min-sort-speedup]
+
+set bench_script {
+    set auto_path [linsert $auto_path 0 $::libdir]
+    package require ksuid
+
+    set batch_size 100
+
+    proc fresh_strings {ksuids} {
+        # new objects carrying only a string representation
+        lmap ksuid $ksuids {string range $ksuid 0 end}
+    }
+
+    proc bench_command {name iterations setup script} {
+        global batch_size
+        set samples [list]
+        set total 0
+        for {set i 0} {$i < $iterations} {incr i} {
+            uplevel #0 $setup
+            set start [clock microseconds]
+            uplevel #0 $script
+            set elapsed [expr {[clock microseconds] - $start}]
+            incr total $elapsed
+            lappend samples [expr {$elapsed * 1000.0 / $batch_size}]
+        }
+        list $name $samples [expr {$iterations * $batch_size}] $total
+    }
+
+    proc run_benchmarks {iterations} {
+        global batch_size
+        set ::ksuid [::ksuid::generate_ksuid]
+        set ::parts [::ksuid::ksuid_to_parts $::ksuid]
+        set ::ksuids [::ksuid::generate_many $batch_size]
+        set ::bytes [string repeat "\x01\xab" 8]
+        set ::hex [::ksuid::hex_encode $::bytes]
+
+        set benchmarks {
+            generate_ksuid {} {
+                foreach k $::ksuids {::ksuid::generate_ksuid}
+            }
+            generate_many_100 {} {
+                ::ksuid::generate_many 100
+            }
+            generate_binary_100 {} {
+                ::ksuid::generate_binary 100
+            }
+            decode_binary_100 {set ::inputs [fresh_strings $::ksuids]} {
+                ::ksuid::decode_binary $::inputs
+            }
+            ksuid_to_parts {set ::inputs [fresh_strings $::ksuids]} {
+                foreach k $::inputs {::ksuid::ksuid_to_parts $k}
+            }
+            ksuid_to_parts_cached {set ::inputs $::ksuids} {
+                foreach k $::inputs {::ksuid::ksuid_to_parts $k}
+            }
+            timestamp {set ::inputs [fresh_strings $::ksuids]} {
+                foreach k $::inputs {::ksuid::timestamp $k}
+            }
+            parts_to_ksuid {} {
+                foreach k $::ksuids {::ksuid::parts_to_ksuid $::parts}
+            }
+            next_ksuid {set ::inputs [fresh_strings $::ksuids]} {
+                foreach k $::inputs {::ksuid::next_ksuid $k}
+            }
+            prev_ksuid {set ::inputs [fresh_strings $::ksuids]} {
+                foreach k $::inputs {::ksuid::prev_ksuid $k}
+            }
+            hex_encode {} {
+                foreach k $::ksuids {::ksuid::hex_encode $::bytes}
+            }
+            hex_decode {} {
+                foreach k $::ksuids {::ksuid::hex_decode $::hex}
+            }
+        }
+
+        set results [list]
+        foreach {name setup script} $benchmarks {
+            lappend results [bench_command $name $iterations $setup $script]
+        }
+        return $results
+    }
+}
+
+proc percentile {sorted p} {
+    set n [llength $sorted]
+    if {$n == 0} {
+        return 0
+    }
+    set index [expr {min($n - 1, int($n * $p / 100.0))}]
+    lindex $sorted $index
+}
+
+proc merge_results {per_thread_results} {
+    # name -> {samples ops total_us_per_thread}
+    set merged [dict create]
+    foreach results $per_thread_results {
+        foreach result $results {
+            lassign $result name samples ops total
+            dict lappend merged $name [list $samples $ops $total]
+        }
+    }
+
+    set json_entries [list]
+    dict for {name runs} $merged {
+        set samples [list]
+        set ops 0
+        set max_total 0
+        foreach run $runs {
+            lassign $run run_samples run_ops run_total
+            lappend samples {*}$run_samples
+            incr ops $run_ops
+            set max_total [expr {max($max_total, $run_total)}]
+        }
+        # threads run concurrently, so the slowest one bounds the wall time
+        set ops_per_sec [expr {$max_total > 0 ? $ops * 1e6 / $max_total : 0}]
+        set sorted [lsort -real $samples]
+        lappend json_entries [format {    {"name": "%s", "ops_per_sec": %.0f, "p50_ns": %.1f, "p99_ns": %.1f}} \
+            $name $ops_per_sec [percentile $sorted 50] [percentile $sorted 99]]
+    }
+    return $json_entries
+}
+
+if {$threads <= 1} {
+    eval $bench_script
+    set per_thread_results [list [run_benchmarks $iterations]]
+} else {
+    package require Thread
+    set thread_ids [list]
+    for {set i 0} {$i < $threads} {incr i} {
+        set tid [thread::create]
+        thread::send $tid [list set ::libdir $libdir]
+        thread::send $tid $bench_script
+        lappend thread_ids $tid
+    }
+
+    foreach tid $thread_ids {
+        thread::send -async $tid [list run_benchmarks $iterations] ::results($tid)
+    }
+    foreach tid $thread_ids {
+        if {![info exists ::results($tid)]} {
+            vwait ::results($tid)
+        }
+    }
+
+    set per_thread_results [list]
+    foreach tid $thread_ids {
+        lappend per_thread_results $::results($tid)
+        thread::release $tid
+    }
+}
+
+# Best of five runs of each sort, on new string objects every time so that
+# neither command finds ksuid internal reps left over by the other.
+proc bench_sort {count} {
+    set ::auto_path [linsert $::auto_path 0 $::libdir]
+    package require ksuid
+    set shuffled [lmap pair [lsort -index 0 [lmap ksuid [::ksuid::generate_many $count] {
+        list [expr {rand()}] $ksuid
+    }]] {lindex $pair 1}]
+    set best [dict create lsort Inf ::ksuid::sort Inf]
+    for {set i 0} {$i < 5} {incr i} {
+        foreach command {lsort ::ksuid::sort} {
+            set inputs [lmap ksuid $shuffled {string range $ksuid 0 end}]
+            set elapsed [lindex [time {$command $inputs}] 0]
+            dict set best $command [expr {min([dict get $best $command], $elapsed)}]
+        }
+    }
+    list [dict get $best lsort] [dict get $best ::ksuid::sort]
+}
+
+lassign [bench_sort $sort_count] lsort_us sort_us
+set sort_speedup [expr {double($lsort_us) / max($sort_us, 1)}]
+
+puts "\{"
+puts "  \"threads\": $threads,"
+puts "  \"iterations\": $iterations,"
+puts "  \"benchmarks\": \["
+puts [join [merge_results $per_thread_results] ",\n"]
+puts "  \],"
+puts [format {  "sort": {"count": %d, "lsort_us": %d, "ksuid_sort_us": %d, "speedup": %.1f}} \
+    $sort_count $lsort_us $sort_us $sort_speedup]
+puts "\}"
+
+if {$sort_speedup < $min_sort_speedup} {
+    puts stderr [format "::ksuid::sort is %.1fx faster than lsort, expected at least %sx" $sort_speedup $min_sort_speedup]
+    exit 1
+}
@@ -0,0 +1,176 @@
+/**
+ * Copyright Jerily LTD. All Rights Reserved.
+ * SPDX-FileCopyrightText: 2023 Neofytos Dimitriou (neo@jerily.cy)
+ * SPDX-License-Identifier: MIT.
+ */
+
+// Microbenchmarks for the raw encode/decode/arithmetic routines.
+//
+// Usage: ksuid_bench ?batches?
+//
+// Every benchmark runs "batches" timed batches of a fixed number of calls and
+// reports the throughput over all batches together with the median and 99th
+// percentile of the per-call time within a batch. The results are printed to
+// stdout as JSON.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../src/base62.h"
+#include "../src/hex.h"
+#include "../src/custom_uint128.h"
+#include "../src/csprng.h"
+
+typedef struct {
+    std::string name;
+    size_t bytes_per_op;
+    double ops_per_sec;
+    double p50_ns;
+    double p99_ns;
+} bench_result_t;
+
+// written to by every benchmark so that the compiler cannot drop the work
+static volatile unsigned long bench_sink;
+
+template<typename F>
+static bench_result_t bench_run(const char *name, size_t batches, size_t batch_size, size_t bytes_per_op, F op) {
+    // warm up caches and branch predictors
+    for (size_t i = 0; i < batch_size; i++) {
+        op(i);
+    }
+
+    std::vector<double> per_op_ns(batches);
+    double total_ns = 0;
+    for (size_t b = 0; b < batches; b++) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batch_size; i++) {
+            op(i);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        per_op_ns[b] = ns / batch_size;
+        total_ns += ns;
+    }
+
+    std::sort(per_op_ns.begin(), per_op_ns.end());
+    bench_result_t result;
+    result.name = name;
+    result.bytes_per_op = bytes_per_op;
+    result.ops_per_sec = total_ns > 0 ? (batches * batch_size) / (total_ns / 1e9) : 0;
+    result.p50_ns = per_op_ns[batches / 2];
+    result.p99_ns = per_op_ns[std::min(batches - 1, (batches * 99) / 100)];
+    return result;
+}
+
+static void bench_print_json(const std::vector<bench_result_t> &results) {
+    printf("{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        auto &r = results[i];
+        printf("    {\"name\": \"%s\", \"bytes_per_op\": %zu, \"ops_per_sec\": %.0f, \"p50_ns\": %.2f, \"p99_ns\": %.2f}%s\n",
+               r.name.c_str(), r.bytes_per_op, r.ops_per_sec, r.p50_ns, r.p99_ns, i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+    size_t batches = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000;
+    if (batches == 0) {
+        fprintf(stderr, "Usage: %s ?batches?\n", argv[0]);
+        return 1;
+    }
+
+    csprng_init();
+    csprng_t rng;
+    memset(&rng, 0, sizeof(rng));
+
+    // a pool of random ksuids and their encodings, so that the inputs vary
+    const size_t pool_size = 1024;
+    std::vector<unsigned char> raw(pool_size * 20);
+    csprng_bytes(&rng, raw.data(), raw.size());
+    std::vector<unsigned char> encoded(pool_size * 27);
+    for (size_t i = 0; i < pool_size; i++) {
+        unsigned char input[20];
+        memcpy(input, raw.data() + i * 20, 20);
+        base62_encode(input, 20, encoded.data() + i * 27, 27);
+    }
+
+    const size_t blob_size = 64 * 1024;
+    std::vector<unsigned char> blob(blob_size);
+    csprng_bytes(&rng, blob.data(), blob.size());
+    std::vector<char> blob_hex(blob_size * 2);
+    hex_encode(blob.data(), blob_size, blob_hex.data());
+    std::vector<unsigned char> blob_out(blob_size);
+
+    std::vector<bench_result_t> results;
+
+    results.push_back(bench_run("base62_encode", batches, 1000, 20, [&](size_t i) {
+        unsigned char input[20];
+        unsigned char output[27];
+        memcpy(input, raw.data() + (i % pool_size) * 20, 20);
+        base62_encode(input, 20, output, 27);
+        bench_sink += output[26];
+    }));
+
+    results.push_back(bench_run("base62_decode", batches, 1000, 27, [&](size_t i) {
+        unsigned char output[20];
+        base62_decode(encoded.data() + (i % pool_size) * 27, output);
+        bench_sink += output[19];
+    }));
+
+    results.push_back(bench_run("base62_decode_timestamp", batches, 1000, 27, [&](size_t i) {
+        uint32_t timestamp;
+        base62_decode_timestamp(encoded.data() + (i % pool_size) * 27, &timestamp);
+        bench_sink += timestamp;
+    }));
+
+    results.push_back(bench_run("hex_encode_16", batches, 1000, 16, [&](size_t i) {
+        char hex[32];
+        hex_encode(raw.data() + (i % pool_size) * 20 + 4, 16, hex);
+        bench_sink += hex[31];
+    }));
+
+    results.push_back(bench_run("hex_decode_16", batches, 1000, 32, [&](size_t i) {
+        unsigned char output[16];
+        hex_decode(blob_hex.data() + (i % 1024) * 32, 32, output);
+        bench_sink += output[15];
+    }));
+
+    results.push_back(bench_run("hex_encode_64k", batches / 10 + 1, 10, blob_size, [&](size_t i) {
+        hex_encode(blob.data(), blob_size, blob_hex.data());
+        bench_sink += blob_hex[i];
+    }));
+
+    results.push_back(bench_run("hex_decode_64k", batches / 10 + 1, 10, blob_size * 2, [&](size_t i) {
+        hex_decode(blob_hex.data(), blob_size * 2, blob_out.data());
+        bench_sink += blob_out[i];
+    }));
+
+    results.push_back(bench_run("add128", batches, 1000, 16, [&](size_t i) {
+        auto x = make_uint128_from_bytes(raw.data() + (i % pool_size) * 20 + 4);
+        auto y = make_uint128(i, 0);
+        auto z = add128(x, y);
+        unsigned char output[16];
+        uint128_to_bytes(z, output);
+        bench_sink += output[15];
+    }));
+
+    results.push_back(bench_run("incr128", batches, 1000, 16, [&](size_t i) {
+        auto x = make_uint128_from_bytes(raw.data() + (i % pool_size) * 20 + 4);
+        incr128(x);
+        bench_sink += x.lo;
+    }));
+
+    results.push_back(bench_run("csprng_bytes_16", batches, 1000, 16, [&](size_t) {
+        unsigned char output[16];
+        csprng_bytes(&rng, output, 16);
+        bench_sink += output[15];
+    }));
+
+    bench_print_json(results);
+    csprng_destroy(&rng);
+    return 0;
+}
@@ -1,10 +1,65 @@
+#include <cstring>
 #include "base62.h"
+#include "custom_uint128.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BASE62_HAVE_X86_64 1
+#include <emmintrin.h>
+#endif
 
 static char BASE_62_CHARACTERS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
 
+// 62^5, the largest power of 62 that fits in 32 bits
+static const uint32_t BASE_62_POW_5 = 916132832;
+
+// Specialization of base62_encode for 20-byte ksuids and 27-character output,
+// callers that know their sizes at compile time use it directly.
+// Same idea as fastEncodeBase62 in Segment's ksuid: long division over five
+// 32-bit limbs instead of bytes, with a constant divisor the compiler turns
+// into a multiplication. Dividing by 62^5 yields five digits per pass, so the
+// whole number is converted in five passes without any allocation.
+void base62_encode_ksuid(const unsigned char input[BASE62_KSUID_BYTES], unsigned char output[BASE62_KSUID_LENGTH]) {
+    uint32_t parts[5];
+    for (int i = 0; i < 5; i++) {
+        parts[i] = ((uint32_t) input[i * 4] << 24)
+                   | ((uint32_t) input[i * 4 + 1] << 16)
+                   | ((uint32_t) input[i * 4 + 2] << 8)
+                   | ((uint32_t) input[i * 4 + 3]);
+    }
+
+    auto offset = BASE62_KSUID_LENGTH;
+    auto first = 0;
+    for (int pass = 0; pass < 5; pass++) {
+        uint64_t remainder = 0;
+        for (int i = first; i < 5; i++) {
+            uint64_t value = (remainder << 32) | parts[i];
+            parts[i] = (uint32_t) (value / BASE_62_POW_5);
+            remainder = value % BASE_62_POW_5;
+        }
+        while (first < 5 && parts[first] == 0) {
+            first++;
+        }
+
+        auto digits = (uint32_t) remainder;
+        for (int i = 0; i < 5; i++) {
+            output[--offset] = BASE_62_CHARACTERS[digits % 62];
+            digits /= 62;
+        }
+    }
+
+    // 2^160 < 62^27, so what is left is below 62^2 and sits in the last limb
+    output[1] = BASE_62_CHARACTERS[parts[4] % 62];
+    output[0] = BASE_62_CHARACTERS[parts[4] / 62];
+}
+
 int base62_encode(unsigned char timestamp_and_payload_bytes[], int input_length,
                   unsigned char output[], int output_length) {
 
+    if (input_length == BASE62_KSUID_BYTES && output_length == BASE62_KSUID_LENGTH) {
+        base62_encode_ksuid(timestamp_and_payload_bytes, output);
+        return TCL_OK;
+    }
+
     auto offset = output_length;
     auto input = timestamp_and_payload_bytes;
     while (input_length > 0) {
@@ -34,78 +89,242 @@ int base62_encode(unsigned char timestamp_and_payload_bytes[], int input_length,
     return TCL_OK;
 }
 
-static unsigned char base62_value(unsigned char digit) {
-    static unsigned char offsetUppercase = 10;
-    static unsigned char offsetLowercase = 36;
-
-	if (digit >= '0' && digit <= '9') {
-        return digit - '0';
-    } else if (digit >= 'A' && digit <= 'Z') {
-        return offsetUppercase + (digit - 'A');
-    } else {
-		return offsetLowercase + (digit - 'a');
-	}
+// Maps an ASCII character to its base62 digit value, or 0xFF if the
+// character is not part of the base62 alphabet.
+static const unsigned char BASE_62_VALUES[256] = {
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+          0,   1,   2,   3,   4,   5,   6,   7,   8,   9, 255, 255, 255, 255, 255, 255,
+        255,  10,  11,  12,  13,  14,  15,  16,  17,  18,  19,  20,  21,  22,  23,  24,
+         25,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35, 255, 255, 255, 255, 255,
+        255,  36,  37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,
+         51,  52,  53,  54,  55,  56,  57,  58,  59,  60,  61, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+};
+
+#if defined(CUSTOM_UINT128_HAVE_INT128)
+
+// 62^19 split into two 64-bit halves, and 62^10
+static const uint64_t BASE_62_POW_19_HI = 0x0002302c69c73c90ULL;
+static const uint64_t BASE_62_POW_19_LO = 0x73d73d0eb2f80000ULL;
+static const uint64_t BASE_62_POW_10 = 839299365868340224ULL;
+
+// The sizes are fixed: src is 27 bytes long and dst is 20 bytes long.
+//
+// Same split as base62_decode_timestamp: the value is A * 62^19 + R with A
+// formed by the first 8 digits and R by the last 19. The digits go into three
+// independent 64-bit accumulators (8, 9 and 10 digits) and are combined with
+// four 64x64->128 multiplications, instead of carrying a multiplication
+// through five 32-bit limbs for every group of five digits. This is the hot
+// loop of ::ksuid::sort on string lists. Invalid characters and values that
+// do not fit in 160 bits are rejected.
+int base62_decode(const unsigned char src[BASE62_KSUID_LENGTH], unsigned char dst[BASE62_KSUID_BYTES]) {
+    unsigned char invalid = 0;
+    uint64_t a = 0;
+    uint64_t b = 0;
+    uint64_t c = 0;
+    for (int i = 0; i < 8; i++) {
+        auto d = BASE_62_VALUES[src[i]];
+        invalid |= d;
+        a = a * 62 + d;
+    }
+    for (int i = 8; i < 17; i++) {
+        auto d = BASE_62_VALUES[src[i]];
+        invalid |= d;
+        b = b * 62 + d;
+    }
+    for (int i = 17; i < BASE62_KSUID_LENGTH; i++) {
+        auto d = BASE_62_VALUES[src[i]];
+        invalid |= d;
+        c = c * 62 + d;
+    }
+    if (invalid & 0x80) {
+        return TCL_ERROR;
+    }
+
+    // R < 62^19 < 2^114 and A * (62^19 mod 2^64) < 2^112, so the low sum
+    // cannot overflow 128 bits; the high part must stay below 2^96.
+    unsigned __int128 low = (unsigned __int128) b * BASE_62_POW_10 + c
+                            + (unsigned __int128) a * BASE_62_POW_19_LO;
+    unsigned __int128 high = (unsigned __int128) a * BASE_62_POW_19_HI + (uint64_t) (low >> 64);
+    if (high >> 96) {
+        return TCL_ERROR;
+    }
+
+    auto top = (uint32_t) (high >> 64);
+    dst[0] = (unsigned char) (top >> 24);
+    dst[1] = (unsigned char) (top >> 16);
+    dst[2] = (unsigned char) (top >> 8);
+    dst[3] = (unsigned char) top;
+    uint128_store_be64((uint64_t) high, dst + 4);
+    uint128_store_be64((uint64_t) low, dst + 12);
+    return TCL_OK;
 }
 
-// In order to support a couple of optimizations the function assumes that src
-// is 27 bytes long and dst is 20 bytes long.
-int base62_decode(const unsigned char src[], unsigned char dst[]) {
-
-    // Create a vector of size 27 to store the ksuid bytes
-    unsigned char input[27];
-    input[0] = base62_value(src[0]);
-    input[1] = base62_value(src[1]);
-    input[2] = base62_value(src[2]);
-    input[3] = base62_value(src[3]);
-    input[4] = base62_value(src[4]);
-    input[5] = base62_value(src[5]);
-    input[6] = base62_value(src[6]);
-    input[7] = base62_value(src[7]);
-    input[8] = base62_value(src[8]);
-    input[9] = base62_value(src[9]);
-    input[10] = base62_value(src[10]);
-    input[11] = base62_value(src[11]);
-    input[12] = base62_value(src[12]);
-    input[13] = base62_value(src[13]);
-    input[14] = base62_value(src[14]);
-    input[15] = base62_value(src[15]);
-    input[16] = base62_value(src[16]);
-    input[17] = base62_value(src[17]);
-    input[18] = base62_value(src[18]);
-    input[19] = base62_value(src[19]);
-    input[20] = base62_value(src[20]);
-    input[21] = base62_value(src[21]);
-    input[22] = base62_value(src[22]);
-    input[23] = base62_value(src[23]);
-    input[24] = base62_value(src[24]);
-    input[25] = base62_value(src[25]);
-    input[26] = base62_value(src[26]);
-
-    auto input_length = 27;
-    auto offset = 20;
-    while (input_length > 0) {
-        if (offset == 0) {
+#else
+
+// The sizes are fixed: src is 27 bytes long and dst is 20 bytes long.
+//
+// The digits are consumed five at a time and folded into five 32-bit limbs
+// (limbs = limbs * 62^5 + chunk). Invalid characters and values that do not
+// fit in 160 bits, i.e. anything above MAX_STRING_ENCODED, are rejected.
+int base62_decode(const unsigned char src[BASE62_KSUID_LENGTH], unsigned char dst[BASE62_KSUID_BYTES]) {
+
+    // Invalid characters map to 0xFF, valid ones stay below 64, so OR-ing all
+    // digit values together tells whether any character was invalid.
+    unsigned char invalid = 0;
+
+    uint32_t parts[5] = {0, 0, 0, 0, 0};
+    auto d0 = BASE_62_VALUES[src[0]];
+    auto d1 = BASE_62_VALUES[src[1]];
+    invalid |= d0 | d1;
+    parts[4] = d0 * 62 + d1;
+
+    for (int chunk = 0; chunk < 5; chunk++) {
+        auto digits = src + 2 + chunk * 5;
+        uint32_t value = 0;
+        for (int i = 0; i < 5; i++) {
+            auto d = BASE_62_VALUES[digits[i]];
+            invalid |= d;
+            value = value * 62 + d;
+        }
+
+        uint64_t carry = value;
+        for (int i = 4; i >= 0; i--) {
+            uint64_t product = (uint64_t) parts[i] * BASE_62_POW_5 + carry;
+            parts[i] = (uint32_t) product;
+            carry = product >> 32;
+        }
+        if (carry != 0) {
             return TCL_ERROR;
         }
-        std::vector<unsigned char> quotients;
-        unsigned long remainder = 0;
-        for (int i = 0; i < input_length; i++) {
-            auto b = input[i];
-            auto accumulator = (remainder * 62) + b;
-            auto quotient = accumulator / 256;
-            remainder = accumulator % 256;
-            if (!quotients.empty() || quotient != 0) {
-                quotients.push_back(quotient);
-            }
+    }
+
+    if (invalid & 0x80) {
+        return TCL_ERROR;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        dst[i * 4] = (unsigned char) (parts[i] >> 24);
+        dst[i * 4 + 1] = (unsigned char) (parts[i] >> 16);
+        dst[i * 4 + 2] = (unsigned char) (parts[i] >> 8);
+        dst[i * 4 + 3] = (unsigned char) parts[i];
+    }
+
+    return TCL_OK;
+}
+
+#endif
+
+// The largest valid ksuid, 2^160 - 1. The alphabet is in ASCII order, so
+// comparing encoded ksuids bytewise compares the numbers they encode.
+static const unsigned char BASE_62_MAX_ENCODED[] = "aWgEPTl1tmebfsQzFP4bxwgy80V";
+
+// 62^19 and 62^19 - 1 as four big endian 32-bit limbs. The last 19 digits of
+// a ksuid contribute at most 62^19 - 1.
+static const uint32_t BASE_62_POW_19[4] = {0x0002302c, 0x69c73c90, 0x73d73d0e, 0xb2f80000};
+static const uint32_t BASE_62_POW_19_MINUS_1[4] = {0x0002302c, 0x69c73c90, 0x73d73d0e, 0xb2f7ffff};
+
+#ifdef BASE62_HAVE_X86_64
+
+// Bit i is set if byte i of the 16 at p is in the base62 alphabet, i.e. one
+// of 0-9, A-Z or a-z. Bytes above 0x7F are negative as signed chars and fall
+// outside all three ranges.
+static inline unsigned int base62_alphabet_mask_sse2(const unsigned char *p) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('z' + 1)));
+    return (unsigned int) _mm_movemask_epi8(_mm_or_si128(digit, _mm_or_si128(upper, lower)));
+}
+
+#endif
+
+// Checks that a 27-character string is a valid ksuid without decoding it:
+// every character must be in the alphabet and the string must not sort
+// after the largest valid ksuid. On x86-64 the 27 characters are checked as
+// two overlapping 16-byte vectors.
+int base62_validate(const unsigned char src[BASE62_KSUID_LENGTH]) {
+#ifdef BASE62_HAVE_X86_64
+    if ((base62_alphabet_mask_sse2(src) & base62_alphabet_mask_sse2(src + BASE62_KSUID_LENGTH - 16)) != 0xFFFF) {
+        return TCL_ERROR;
+    }
+#else
+    unsigned char invalid = 0;
+    for (int i = 0; i < BASE62_KSUID_LENGTH; i++) {
+        invalid |= BASE_62_VALUES[src[i]];
+    }
+    if (invalid & 0x80) {
+        return TCL_ERROR;
+    }
+#endif
+    if (memcmp(src, BASE_62_MAX_ENCODED, BASE62_KSUID_LENGTH) > 0) {
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+// Decodes only the timestamp, i.e. the top 32 bits, of a 27-character ksuid.
+//
+// The value is A * 62^19 + R where A is the number formed by the first 8
+// digits (below 2^48) and R < 62^19 < 2^128 the one formed by the last 19.
+// A * 62^19 is computed exactly; its top 32 bits are the timestamp unless
+// adding R carries into them, which can only happen when the low 128 bits
+// of A * 62^19 are within 62^19 of 2^128 (about one ksuid in 30000). Those
+// fall back to the full decode. The remaining digits are still validated.
+int base62_decode_timestamp(const unsigned char src[BASE62_KSUID_LENGTH], uint32_t *timestamp) {
+    if (TCL_OK != base62_validate(src)) {
+        return TCL_ERROR;
+    }
+
+    uint64_t a = 0;
+    for (int i = 0; i < 8; i++) {
+        a = a * 62 + BASE_62_VALUES[src[i]];
+    }
+
+    // product = 62^19 * A, schoolbook over the two 32-bit halves of A. The
+    // value is at most 2^160 - 1, so five limbs hold it and the carry out of
+    // the upper half is always zero.
+    uint32_t product[5] = {0, 0, 0, 0, 0};
+    uint32_t factors[2] = {(uint32_t) a, (uint32_t) (a >> 32)};
+    for (int shift = 0; shift < 2; shift++) {
+        uint64_t carry = 0;
+        for (int i = 3; i >= 0; i--) {
+            int k = i + 1 - shift;
+            uint64_t t = (uint64_t) BASE_62_POW_19[i] * factors[shift] + product[k] + carry;
+            product[k] = (uint32_t) t;
+            carry = t >> 32;
+        }
+        if (shift == 0) {
+            product[0] = (uint32_t) carry;
         }
-        dst[--offset] = remainder;
-        std::copy(quotients.begin(), quotients.end(), input);
-        input_length = quotients.size();
     }
 
-    while (offset > 0) {
-        dst[--offset] = 0;
+    // adding the largest possible R to the low 128 bits must not carry
+    uint64_t overflow = 0;
+    for (int i = 3; i >= 0; i--) {
+        overflow = ((uint64_t) product[i + 1] + BASE_62_POW_19_MINUS_1[i] + overflow) >> 32;
+    }
+    if (overflow) {
+        unsigned char bytes[BASE62_KSUID_BYTES];
+        if (TCL_OK != base62_decode(src, bytes)) {
+            return TCL_ERROR;
+        }
+        *timestamp = ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) | ((uint32_t) bytes[2] << 8) | bytes[3];
+        return TCL_OK;
     }
 
+    *timestamp = product[0];
     return TCL_OK;
 }
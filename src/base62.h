@@ -2,9 +2,16 @@
 #define KSUID_TCL_BASE62_H
 
 #include <tcl.h>
+#include <cstdint>
 #include <vector>
 
+#define BASE62_KSUID_BYTES 20
+#define BASE62_KSUID_LENGTH 27
+
 int base62_encode(unsigned char input[], int input_length, unsigned char output[], int output_length);
-int base62_decode(const unsigned char src[], unsigned char dst[]);
+void base62_encode_ksuid(const unsigned char input[BASE62_KSUID_BYTES], unsigned char output[BASE62_KSUID_LENGTH]);
+int base62_decode(const unsigned char src[BASE62_KSUID_LENGTH], unsigned char dst[BASE62_KSUID_BYTES]);
+int base62_validate(const unsigned char src[BASE62_KSUID_LENGTH]);
+int base62_decode_timestamp(const unsigned char src[BASE62_KSUID_LENGTH], uint32_t *timestamp);
 
 #endif //KSUID_TCL_BASE62_H
@@ -0,0 +1,212 @@
+#include <cerrno>
+#include <cstring>
+#include <random>
+#include "csprng.h"
+
+#if defined(__linux__)
+#include <sys/random.h>
+#elif defined(__APPLE__) || defined(__OpenBSD__) || defined(__FreeBSD__)
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+// A buffered chacha20 keystream generator with "fast key erasure": every refill
+// produces CSPRNG_BUFFER_SIZE bytes, the first 32 of which immediately become the
+// key for the next refill and are wiped. Fresh entropy from the operating system
+// is mixed into the key on first use, after a fork and every CSPRNG_RESEED_BYTES.
+
+#define CSPRNG_KEY_BYTES 32
+#define CSPRNG_RESEED_BYTES (1600 * 1024)
+
+// bumped in the child after fork(), so that every thread's generator reseeds
+// instead of handing out the same bytes as the parent
+static volatile unsigned long csprng_fork_generation = 0;
+
+#ifndef _WIN32
+static void csprng_AtForkChild() {
+    csprng_fork_generation++;
+}
+#endif
+
+void csprng_init() {
+#ifndef _WIN32
+    pthread_atfork(nullptr, nullptr, csprng_AtForkChild);
+#endif
+}
+
+static void csprng_wipe(void *ptr, size_t length) {
+    volatile unsigned char *p = (volatile unsigned char *) ptr;
+    while (length--) {
+        *p++ = 0;
+    }
+}
+
+static int csprng_os_entropy(unsigned char *output, size_t length) {
+#if defined(__linux__)
+    while (length > 0) {
+        ssize_t n = getrandom(output, length, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOSYS) {
+                break;
+            }
+            return TCL_ERROR;
+        }
+        output += n;
+        length -= n;
+    }
+    if (length == 0) {
+        return TCL_OK;
+    }
+#elif defined(__APPLE__) || defined(__OpenBSD__) || defined(__FreeBSD__)
+    // getentropy is limited to 256 bytes per call
+    while (length > 0) {
+        size_t n = length > 256 ? 256 : length;
+        if (getentropy(output, n) != 0) {
+            return TCL_ERROR;
+        }
+        output += n;
+        length -= n;
+    }
+    return TCL_OK;
+#endif
+    try {
+        std::random_device rd;
+        while (length > 0) {
+            unsigned int v = rd();
+            size_t n = length > sizeof(v) ? sizeof(v) : length;
+            memcpy(output, &v, n);
+            output += n;
+            length -= n;
+        }
+    } catch (...) {
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+#define CSPRNG_ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define CSPRNG_QUARTERROUND(a, b, c, d) \
+    a += b; d ^= a; d = CSPRNG_ROTL32(d, 16); \
+    c += d; b ^= c; b = CSPRNG_ROTL32(b, 12); \
+    a += b; d ^= a; d = CSPRNG_ROTL32(d, 8);  \
+    c += d; b ^= c; b = CSPRNG_ROTL32(b, 7);
+
+static void chacha20_block(const uint32_t input[16], unsigned char output[64]) {
+    uint32_t x[16];
+    memcpy(x, input, sizeof(x));
+
+    for (int i = 0; i < 10; i++) {
+        // column rounds
+        CSPRNG_QUARTERROUND(x[0], x[4], x[8], x[12])
+        CSPRNG_QUARTERROUND(x[1], x[5], x[9], x[13])
+        CSPRNG_QUARTERROUND(x[2], x[6], x[10], x[14])
+        CSPRNG_QUARTERROUND(x[3], x[7], x[11], x[15])
+        // diagonal rounds
+        CSPRNG_QUARTERROUND(x[0], x[5], x[10], x[15])
+        CSPRNG_QUARTERROUND(x[1], x[6], x[11], x[12])
+        CSPRNG_QUARTERROUND(x[2], x[7], x[8], x[13])
+        CSPRNG_QUARTERROUND(x[3], x[4], x[9], x[14])
+    }
+
+    // serialize as little endian words regardless of the host byte order
+    for (int i = 0; i < 16; i++) {
+        uint32_t v = x[i] + input[i];
+        output[i * 4] = v & 0xFF;
+        output[i * 4 + 1] = (v >> 8) & 0xFF;
+        output[i * 4 + 2] = (v >> 16) & 0xFF;
+        output[i * 4 + 3] = (v >> 24) & 0xFF;
+    }
+}
+
+static void csprng_key_from_bytes(uint32_t key[8], const unsigned char bytes[CSPRNG_KEY_BYTES]) {
+    for (int i = 0; i < 8; i++) {
+        key[i] = ((uint32_t) bytes[i * 4])
+                 | ((uint32_t) bytes[i * 4 + 1] << 8)
+                 | ((uint32_t) bytes[i * 4 + 2] << 16)
+                 | ((uint32_t) bytes[i * 4 + 3] << 24);
+    }
+}
+
+static int csprng_reseed(csprng_t *rng) {
+    unsigned char entropy[CSPRNG_KEY_BYTES];
+    if (TCL_OK != csprng_os_entropy(entropy, CSPRNG_KEY_BYTES)) {
+        return TCL_ERROR;
+    }
+
+    uint32_t fresh[8];
+    csprng_key_from_bytes(fresh, entropy);
+    for (int i = 0; i < 8; i++) {
+        rng->key[i] ^= fresh[i];
+    }
+    csprng_wipe(entropy, sizeof(entropy));
+    csprng_wipe(fresh, sizeof(fresh));
+
+    // discard whatever is left from the previous key
+    csprng_wipe(rng->buffer, CSPRNG_BUFFER_SIZE);
+    rng->available = 0;
+    rng->bytes_since_reseed = 0;
+    rng->fork_generation = csprng_fork_generation;
+    rng->seeded = 1;
+    return TCL_OK;
+}
+
+static void csprng_refill(csprng_t *rng) {
+    uint32_t input[16];
+    input[0] = 0x61707865; // "expand 32-byte k"
+    input[1] = 0x3320646e;
+    input[2] = 0x79622d32;
+    input[3] = 0x6b206574;
+    memcpy(input + 4, rng->key, sizeof(rng->key));
+    input[12] = 0; // block counter
+    input[13] = 0;
+    input[14] = 0; // nonce, the key is never reused so it can stay zero
+    input[15] = 0;
+
+    for (int i = 0; i < CSPRNG_BUFFER_SIZE / 64; i++) {
+        input[12] = i;
+        chacha20_block(input, rng->buffer + i * 64);
+    }
+    csprng_wipe(input, sizeof(input));
+
+    // fast key erasure: the head of the keystream becomes the next key
+    csprng_key_from_bytes(rng->key, rng->buffer);
+    csprng_wipe(rng->buffer, CSPRNG_KEY_BYTES);
+    rng->available = CSPRNG_BUFFER_SIZE - CSPRNG_KEY_BYTES;
+}
+
+int csprng_bytes(csprng_t *rng, unsigned char *output, size_t length) {
+    if (!rng->seeded
+        || rng->fork_generation != csprng_fork_generation
+        || rng->bytes_since_reseed >= CSPRNG_RESEED_BYTES) {
+        if (TCL_OK != csprng_reseed(rng)) {
+            return TCL_ERROR;
+        }
+    }
+
+    rng->bytes_since_reseed += length;
+    while (length > 0) {
+        if (rng->available == 0) {
+            csprng_refill(rng);
+        }
+        size_t n = length < rng->available ? length : rng->available;
+        unsigned char *src = rng->buffer + CSPRNG_BUFFER_SIZE - rng->available;
+        memcpy(output, src, n);
+        // bytes handed out are never kept around
+        memset(src, 0, n);
+        rng->available -= n;
+        output += n;
+        length -= n;
+    }
+    return TCL_OK;
+}
+
+void csprng_destroy(csprng_t *rng) {
+    csprng_wipe(rng, sizeof(csprng_t));
+}
@@ -0,0 +1,24 @@
+#ifndef KSUID_TCL_CSPRNG_H
+#define KSUID_TCL_CSPRNG_H
+
+#include <tcl.h>
+#include <cstddef>
+#include <cstdint>
+
+// number of keystream bytes produced per refill (64 chacha20 blocks)
+#define CSPRNG_BUFFER_SIZE 4096
+
+typedef struct {
+    uint32_t key[8];
+    unsigned char buffer[CSPRNG_BUFFER_SIZE];
+    size_t available;
+    size_t bytes_since_reseed;
+    unsigned long fork_generation;
+    int seeded;
+} csprng_t;
+
+void csprng_init();
+int csprng_bytes(csprng_t *rng, unsigned char *output, size_t length);
+void csprng_destroy(csprng_t *rng);
+
+#endif //KSUID_TCL_CSPRNG_H
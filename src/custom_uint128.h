@@ -2,19 +2,153 @@
 #define KSUID_TCL_CUSTOM_UINT128_H
 
 #include <cstdint>
+#include <cstring>
+
+// Unsigned 128-bit arithmetic on the payload of a ksuid. Everything is inline
+// so that next/prev and friends compile down to a few instructions: with
+// unsigned __int128 the compiler emits add/adc and sub/sbb pairs, and the
+// big endian byte conversions are a load plus a byte swap per half.
+
+#if defined(__SIZEOF_INT128__)
+#define CUSTOM_UINT128_HAVE_INT128 1
+#endif
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ \
+    && (defined(__GNUC__) || defined(__clang__))
+#define CUSTOM_UINT128_LOAD_BSWAP 1
+#elif defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define CUSTOM_UINT128_LOAD_NATIVE 1
+#endif
 
 typedef struct {
     uint64_t lo;
     uint64_t hi;
 } custom_uint128_t;
 
-custom_uint128_t make_uint128(uint64_t lo, uint64_t hi);
-custom_uint128_t make_uint128_from_bytes(const unsigned char* bytes);
-custom_uint128_t add128(custom_uint128_t& x, custom_uint128_t& y);
-custom_uint128_t sub128(custom_uint128_t& x, custom_uint128_t& y);
-custom_uint128_t incr128(custom_uint128_t& x);
-custom_uint128_t decr128(custom_uint128_t& x);
-int cmp128(custom_uint128_t& x, custom_uint128_t& y);
-void uint128_to_bytes(custom_uint128_t x, unsigned char* bytes);
+inline constexpr custom_uint128_t make_uint128(uint64_t lo, uint64_t hi) {
+    return custom_uint128_t{lo, hi};
+}
+
+// ---- Byte conversion (big endian, independent of the host byte order) ----
+
+inline uint64_t uint128_load_be64(const unsigned char *bytes) {
+#if defined(CUSTOM_UINT128_LOAD_BSWAP)
+    uint64_t v;
+    memcpy(&v, bytes, sizeof(v));
+    return __builtin_bswap64(v);
+#elif defined(CUSTOM_UINT128_LOAD_NATIVE)
+    uint64_t v;
+    memcpy(&v, bytes, sizeof(v));
+    return v;
+#else
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v = (v << 8) | bytes[i];
+    }
+    return v;
+#endif
+}
+
+inline void uint128_store_be64(uint64_t v, unsigned char *bytes) {
+#if defined(CUSTOM_UINT128_LOAD_BSWAP)
+    v = __builtin_bswap64(v);
+    memcpy(bytes, &v, sizeof(v));
+#elif defined(CUSTOM_UINT128_LOAD_NATIVE)
+    memcpy(bytes, &v, sizeof(v));
+#else
+    for (int i = 7; i >= 0; i--) {
+        bytes[i] = (unsigned char) v;
+        v >>= 8;
+    }
+#endif
+}
+
+inline custom_uint128_t make_uint128_from_bytes(const unsigned char *bytes) {
+    return make_uint128(uint128_load_be64(bytes + 8), uint128_load_be64(bytes));
+}
+
+// The equivalent of uint128_to_bytes in go-lang is:
+//func (v uint128) bytes() (out [16]byte) {
+//    binary.BigEndian.PutUint64(out[:8], v[1]) // high
+//    binary.BigEndian.PutUint64(out[8:], v[0]) // low
+//    return
+//}
+inline void uint128_to_bytes(const custom_uint128_t &x, unsigned char *bytes) {
+    uint128_store_be64(x.hi, bytes);
+    uint128_store_be64(x.lo, bytes + 8);
+}
+
+// ---- Arithmetic (modulo 2^128) ----
+
+#if defined(CUSTOM_UINT128_HAVE_INT128)
+inline unsigned __int128 uint128_to_native(const custom_uint128_t &x) {
+    return ((unsigned __int128) x.hi << 64) | x.lo;
+}
+
+inline custom_uint128_t uint128_from_native(unsigned __int128 x) {
+    return make_uint128((uint64_t) x, (uint64_t) (x >> 64));
+}
+#endif
+
+// Stores x + y in result and returns 1 if the sum wrapped around, 0 otherwise
+inline int add128_overflow(const custom_uint128_t &x, const custom_uint128_t &y, custom_uint128_t *result) {
+#if defined(CUSTOM_UINT128_HAVE_INT128)
+    unsigned __int128 sum = uint128_to_native(x) + uint128_to_native(y);
+    *result = uint128_from_native(sum);
+    return sum < uint128_to_native(x);
+#else
+    uint64_t lo = x.lo + y.lo;
+    uint64_t carry = lo < x.lo;
+    uint64_t hi = x.hi + y.hi;
+    uint64_t carry_out = hi < x.hi;
+    hi += carry;
+    carry_out |= hi < carry;
+    *result = make_uint128(lo, hi);
+    return (int) carry_out;
+#endif
+}
+
+// Stores x - y in result and returns 1 if the difference wrapped around, 0 otherwise
+inline int sub128_overflow(const custom_uint128_t &x, const custom_uint128_t &y, custom_uint128_t *result) {
+#if defined(CUSTOM_UINT128_HAVE_INT128)
+    *result = uint128_from_native(uint128_to_native(x) - uint128_to_native(y));
+    return uint128_to_native(x) < uint128_to_native(y);
+#else
+    uint64_t borrow = x.lo < y.lo;
+    uint64_t lo = x.lo - y.lo;
+    uint64_t hi = x.hi - y.hi - borrow;
+    uint64_t borrow_out = x.hi < y.hi || (x.hi == y.hi && borrow);
+    *result = make_uint128(lo, hi);
+    return (int) borrow_out;
+#endif
+}
+
+inline custom_uint128_t add128(const custom_uint128_t &x, const custom_uint128_t &y) {
+    custom_uint128_t result;
+    add128_overflow(x, y, &result);
+    return result;
+}
+
+inline custom_uint128_t sub128(const custom_uint128_t &x, const custom_uint128_t &y) {
+    custom_uint128_t result;
+    sub128_overflow(x, y, &result);
+    return result;
+}
+
+inline custom_uint128_t incr128(custom_uint128_t &x) {
+    x.lo++;
+    x.hi += x.lo == 0;
+    return x;
+}
+
+inline custom_uint128_t decr128(custom_uint128_t &x) {
+    x.hi -= x.lo == 0;
+    x.lo--;
+    return x;
+}
+
+inline constexpr int cmp128(const custom_uint128_t &x, const custom_uint128_t &y) {
+    return x.hi != y.hi ? (x.hi < y.hi ? -1 : 1) : (x.lo != y.lo ? (x.lo < y.lo ? -1 : 1) : 0);
+}
 
 #endif //KSUID_TCL_CUSTOM_UINT128_H
@@ -1,63 +1,212 @@
-#include <sstream>
-#include <iomanip>
 #include "hex.h"
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HEX_HAVE_X86_64 1
+#include <immintrin.h>
+#endif
+
 static const char* hex_digits = "0123456789abcdef";
 
-// This lookup table allows fast conversion between ASCII hex letters and their
-// corresponding numerical value. The 8-bit range is divided up into 8
-// regions of 0x20 characters each. Each of the three character types (numbers,
-// uppercase, lowercase) falls into different regions of this range. The table
-// contains the amount to subtract from characters in that range to get at
-// the corresponding numerical value.
-//
-// https://chromium.googlesource.com/chromium/src/+/refs/heads/main/url/url_canon_internal.cc#289
-//
-static const char char_to_hex_lookup[8] = {
-        0,         // 0x00 - 0x1f
-        '0',       // 0x20 - 0x3f: digits 0 - 9 are 0x30 - 0x39
-        'A' - 10,  // 0x40 - 0x5f: letters A - F are 0x41 - 0x46
-        'a' - 10,  // 0x60 - 0x7f: letters a - f are 0x61 - 0x66
-        0,         // 0x80 - 0x9F
-        0,         // 0xA0 - 0xBF
-        0,         // 0xC0 - 0xDF
-        0,         // 0xE0 - 0xFF
+// Maps an ASCII character to its hex digit value, or 0xFF if the character
+// is not a hex digit. Upper and lower case letters are both accepted.
+static const unsigned char hex_values[256] = {
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+          0,   1,   2,   3,   4,   5,   6,   7,   8,   9, 255, 255, 255, 255, 255, 255,
+        255,  10,  11,  12,  13,  14,  15, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255,  10,  11,  12,  13,  14,  15, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
 };
 
-static inline int HexCharToValue(unsigned char c) {
-    return c - char_to_hex_lookup[c / 0x20];
+static void hex_encode_scalar(const unsigned char *input, size_t length, char *output) {
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = input[i];
+        output[i * 2] = hex_digits[(c >> 4) & 0xF]; // Extract the high nibble of c and use it as an index in the lookup table
+        output[i * 2 + 1] = hex_digits[c & 0xF]; // Extract the low nibble of c and use it as an index in the lookup table
+    }
+}
+
+static int hex_decode_scalar(const char *input, size_t length, unsigned char *output) {
+    // Invalid characters map to 0xFF, so the OR of all values has the top bit set
+    unsigned char invalid = 0;
+    for (size_t i = 0; i < length / 2; i++) {
+        unsigned char hi = hex_values[(unsigned char) input[i * 2]];
+        unsigned char lo = hex_values[(unsigned char) input[i * 2 + 1]];
+        invalid |= hi | lo;
+        output[i] = (hi << 4) | (lo & 0xF);
+    }
+    return (invalid & 0x80) ? TCL_ERROR : TCL_OK;
+}
+
+#ifdef HEX_HAVE_X86_64
+
+// ---- SSE2 (always available on x86-64) ----
+
+// Turns 16 nibbles (0-15) into their lowercase ASCII hex digits
+static inline __m128i hex_nibbles_to_ascii_sse2(__m128i nibbles) {
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+static size_t hex_encode_sse2(const unsigned char *input, size_t length, char *output) {
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (input + i));
+        __m128i hi = hex_nibbles_to_ascii_sse2(_mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = hex_nibbles_to_ascii_sse2(_mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i *) (output + i * 2), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *) (output + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    return i;
+}
+
+// Converts 16 ASCII characters into their digit values and ORs any invalid
+// character into *invalid as a non-zero byte.
+static inline __m128i hex_ascii_to_nibbles_sse2(__m128i c, __m128i *invalid) {
+    __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    // bytes >= 0x80 are negative in signed compares and fail both ranges
+    __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                     _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), c));
+    __m128i is_letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                      _mm_cmpgt_epi8(_mm_set1_epi8('f' + 1), lower));
+    *invalid = _mm_or_si128(*invalid, _mm_andnot_si128(_mm_or_si128(is_digit, is_letter), _mm_set1_epi8(-1)));
+    __m128i digits = _mm_and_si128(is_digit, _mm_sub_epi8(c, _mm_set1_epi8('0')));
+    __m128i letters = _mm_and_si128(is_letter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)));
+    return _mm_or_si128(digits, letters);
 }
 
-int hex_encode(const unsigned char *str, int length, std::string& output) {
-    for (int i = 0; i < length; i++) {
-        unsigned char c = str[i];
-        output += hex_digits[(c >> 4) & 0xF]; // Extract the high nibble of c and use it as an index in the lookup table
-        output += hex_digits[c & 0xF]; // Extract the low nibble of c and use it as an index in the lookup table
+// Packs pairs of nibbles (high first) held in 16-bit lanes into bytes
+static inline __m128i hex_pack_pairs_sse2(__m128i nibbles) {
+    __m128i hi = _mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00FF)), 4);
+    __m128i lo = _mm_srli_epi16(nibbles, 8);
+    return _mm_or_si128(hi, lo);
+}
+
+static size_t hex_decode_sse2(const char *input, size_t length, unsigned char *output, __m128i *invalid) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m128i a = hex_ascii_to_nibbles_sse2(_mm_loadu_si128((const __m128i *) (input + i)), invalid);
+        __m128i b = hex_ascii_to_nibbles_sse2(_mm_loadu_si128((const __m128i *) (input + i + 16)), invalid);
+        _mm_storeu_si128((__m128i *) (output + i / 2), _mm_packus_epi16(hex_pack_pairs_sse2(a), hex_pack_pairs_sse2(b)));
     }
+    return i;
+}
 
+// ---- AVX2 (selected at runtime) ----
+
+__attribute__((target("avx2")))
+static inline __m256i hex_nibbles_to_ascii_avx2(__m256i nibbles) {
+    __m256i letters = _mm256_and_si256(_mm256_cmpgt_epi8(nibbles, _mm256_set1_epi8(9)), _mm256_set1_epi8('a' - '0' - 10));
+    return _mm256_add_epi8(_mm256_add_epi8(nibbles, _mm256_set1_epi8('0')), letters);
+}
+
+__attribute__((target("avx2")))
+static size_t hex_encode_avx2(const unsigned char *input, size_t length, char *output) {
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (input + i));
+        __m256i hi = hex_nibbles_to_ascii_avx2(_mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i lo = hex_nibbles_to_ascii_avx2(_mm256_and_si256(v, mask));
+        // unpack works within 128-bit lanes, put the lane halves back in order
+        __m256i first = _mm256_unpacklo_epi8(hi, lo);
+        __m256i second = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *) (output + i * 2), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i *) (output + i * 2 + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i hex_ascii_to_nibbles_avx2(__m256i c, __m256i *invalid) {
+    __m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+    __m256i is_digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)),
+                                        _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+    __m256i is_letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+    *invalid = _mm256_or_si256(*invalid, _mm256_andnot_si256(_mm256_or_si256(is_digit, is_letter), _mm256_set1_epi8(-1)));
+    __m256i digits = _mm256_and_si256(is_digit, _mm256_sub_epi8(c, _mm256_set1_epi8('0')));
+    __m256i letters = _mm256_and_si256(is_letter, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10)));
+    return _mm256_or_si256(digits, letters);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i hex_pack_pairs_avx2(__m256i nibbles) {
+    __m256i hi = _mm256_slli_epi16(_mm256_and_si256(nibbles, _mm256_set1_epi16(0x00FF)), 4);
+    __m256i lo = _mm256_srli_epi16(nibbles, 8);
+    return _mm256_or_si256(hi, lo);
+}
+
+__attribute__((target("avx2")))
+static size_t hex_decode_avx2(const char *input, size_t length, unsigned char *output, int *invalid) {
+    __m256i bad = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        __m256i a = hex_ascii_to_nibbles_avx2(_mm256_loadu_si256((const __m256i *) (input + i)), &bad);
+        __m256i b = hex_ascii_to_nibbles_avx2(_mm256_loadu_si256((const __m256i *) (input + i + 32)), &bad);
+        // pack works within 128-bit lanes, restore the order of the 64-bit quarters
+        __m256i packed = _mm256_packus_epi16(hex_pack_pairs_avx2(a), hex_pack_pairs_avx2(b));
+        _mm256_storeu_si256((__m256i *) (output + i / 2), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    *invalid = !_mm256_testz_si256(bad, bad);
+    return i;
+}
+
+static int hex_detect_avx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static int hex_has_avx2() {
+    static const int has_avx2 = hex_detect_avx2();
+    return has_avx2;
+}
+
+#endif
+
+int hex_encode(const unsigned char *input, size_t length, char *output) {
+    size_t done = 0;
+#ifdef HEX_HAVE_X86_64
+    if (hex_has_avx2()) {
+        done = hex_encode_avx2(input, length, output);
+    }
+    done += hex_encode_sse2(input + done, length - done, output + done * 2);
+#endif
+    hex_encode_scalar(input + done, length - done, output + done * 2);
     return TCL_OK;
 }
 
-int hex_decode(const std::string& str, int length, unsigned char *output, int output_length) {
+int hex_decode(const char *input, size_t length, unsigned char *output) {
     // check if length is even
     if (length % 2 != 0) {
         return TCL_ERROR;
     }
-    if (length / 2 > output_length) {
-        return TCL_ERROR;
-    }
 
-    // decode hex encoded "str" into "output", check if it is a valid hex character
-    for (int i = 0; i < output_length; i++) {
-        auto c0 = str[i * 2];
-        auto c1 = str[i * 2 + 1];
-
-        // check if c0 and c1 are valid hex characters
-        if (c0 < 0x20 || c0 > 0x7f || c1 < 0x20 || c1 > 0x7f) {
+    size_t done = 0;
+#ifdef HEX_HAVE_X86_64
+    if (hex_has_avx2()) {
+        int invalid;
+        done = hex_decode_avx2(input, length, output, &invalid);
+        if (invalid) {
             return TCL_ERROR;
         }
-
-        output[i] = (HexCharToValue(c0) << 4) + HexCharToValue(c1);
     }
-    return TCL_OK;
+    __m128i invalid = _mm_setzero_si128();
+    done += hex_decode_sse2(input + done, length - done, output + done / 2, &invalid);
+    if (_mm_movemask_epi8(invalid) != 0) {
+        return TCL_ERROR;
+    }
+#endif
+    return hex_decode_scalar(input + done, length - done, output + done / 2);
 }
@@ -2,10 +2,9 @@
 #define KSUID_TCL_HEX_H
 
 #include <tcl.h>
-#include <vector>
-#include <string>
+#include <cstddef>
 
-int hex_encode(const unsigned char *str, int length, std::string& output);
-int hex_decode(const std::string& str, int length, unsigned char *output, int output_length);
+int hex_encode(const unsigned char *input, size_t length, char *output);
+int hex_decode(const char *input, size_t length, unsigned char *output);
 
 #endif //KSUID_TCL_HEX_H
@@ -4,16 +4,31 @@
  * SPDX-License-Identifier: MIT.
  */
 #include <iostream>
+#include <atomic>
 #include <cstdio>
-#include <random>
+#include <cstring>
 #include <vector>
 #include <algorithm>
+#include <array>
 #include <chrono>
-#include <limits>
+#include <ctime>
+#include <climits>
+#include <cctype>
 #include "library.h"
 #include "base62.h"
 #include "hex.h"
 #include "custom_uint128.h"
+#include "csprng.h"
+#include "radix_sort.h"
+#include "scan.h"
+#include "pool.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #ifndef TCL_SIZE_MAX
 typedef int Tcl_Size;
@@ -32,6 +47,12 @@ typedef int Tcl_Size;
 # define DBG(x)
 #endif
 
+#if defined(__GNUC__) || defined(__clang__)
+# define PREFETCH(address) __builtin_prefetch(address)
+#else
+# define PREFETCH(address)
+#endif
+
 #define CheckArgs(min, max, n, msg) \
                  if ((objc < min) || (objc >max)) { \
                      Tcl_WrongNumArgs(interp, n, objv, msg); \
@@ -52,17 +73,50 @@ typedef int Tcl_Size;
 #define IS_BIG_ENDIAN 0
 #endif
 
+// One-time process-wide setup, done under the mutex when the first interp
+// loads the package. Everything the commands touch afterwards is either
+// thread-specific data or per-interp data, so commands never take a lock.
 static int ksuid_ModuleInitialized;
+TCL_DECLARE_MUTEX(ksuid_ModuleMutex)
+
+#if TCL_MAJOR_VERSION < 9
+// Looked up once, Tcl_GetObjType takes a lock
+static const Tcl_ObjType *ksuid_ByteArrayObjType;
+#endif
+
+typedef struct {
+    int initialized;
+    csprng_t rng;
+    // the per-thread clock, see ksuid_CurrentTime
+    Tcl_WideInt clock_nanos;
+    Tcl_WideInt cached_seconds;
+    Tcl_WideInt cached_epoch;
+    unsigned char cached_timestamp_bytes[4]; // TIMESTAMP_BYTES
+} ThreadSpecificData;
+
+static Tcl_ThreadDataKey dataKey;
+
+// Objects shared by all commands of an interp, e.g. the dict keys of the parts
+typedef struct {
+    Tcl_Obj *timestampKeyPtr;
+    Tcl_Obj *payloadKeyPtr;
+    Tcl_Obj *precisionKeyPtrs[4]; // indexed like KSUID_PRECISIONS
+} ksuid_interp_data_t;
+
+#define KSUID_ASSOC_DATA_KEY "ksuid"
 
 // KSUIDs are 20 bytes:
 //  00-03 byte: uint32 BE UTC timestamp with custom epoch
 //  04-19 byte: random "payload"
 
-static int EPOCH = 1400000000;
-static int PAYLOAD_BYTES = 16;
-static int TIMESTAMP_BYTES = 4;
-static int TOTAL_BYTES = TIMESTAMP_BYTES + PAYLOAD_BYTES;
-static int PAD_TO_LENGTH = 27;
+static const Tcl_WideInt DEFAULT_EPOCH = 1400000000;
+static const int PAYLOAD_BYTES = 16;
+static const int TIMESTAMP_BYTES = 4;
+static const int TOTAL_BYTES = TIMESTAMP_BYTES + PAYLOAD_BYTES;
+static const int PAD_TO_LENGTH = 27;
+
+static_assert(TOTAL_BYTES == BASE62_KSUID_BYTES && PAD_TO_LENGTH == BASE62_KSUID_LENGTH,
+              "the ksuid layout must match the fixed-size base62 routines");
 
 // A string-encoded minimum value for a KSUID
 static char MIN_STRING_ENCODED[] = "000000000000000000000000000";
@@ -99,121 +153,558 @@ unsigned int ksuid_BytesToTimestamp(const unsigned char bytes[]) {
 
 
 
+// ---- The "ksuid" Tcl_ObjType ----
+// The internal representation holds the 20 decoded bytes of the ksuid in
+// twoPtrValue.ptr1, so a value that was produced or parsed once is never
+// base62-decoded again, and the string form is only generated on demand.
+
+static void ksuid_FreeIntRep(Tcl_Obj *objPtr);
+static void ksuid_DupIntRep(Tcl_Obj *srcPtr, Tcl_Obj *dupPtr);
+static void ksuid_UpdateString(Tcl_Obj *objPtr);
+static int ksuid_SetFromAny(Tcl_Interp *interp, Tcl_Obj *objPtr);
+
+static Tcl_ObjType ksuid_ObjType = {
+        "ksuid",
+        ksuid_FreeIntRep,
+        ksuid_DupIntRep,
+        ksuid_UpdateString,
+        ksuid_SetFromAny
+};
+
+#define KSUID_OBJ_BYTES(objPtr) ((unsigned char *) (objPtr)->internalRep.twoPtrValue.ptr1)
+
+static void ksuid_FreeIntRep(Tcl_Obj *objPtr) {
+    ckfree((char *) KSUID_OBJ_BYTES(objPtr));
+    objPtr->internalRep.twoPtrValue.ptr1 = nullptr;
+    objPtr->typePtr = nullptr;
+}
+
+static void ksuid_DupIntRep(Tcl_Obj *srcPtr, Tcl_Obj *dupPtr) {
+    auto bytes = (unsigned char *) ckalloc(TOTAL_BYTES);
+    memcpy(bytes, KSUID_OBJ_BYTES(srcPtr), TOTAL_BYTES);
+    dupPtr->internalRep.twoPtrValue.ptr1 = bytes;
+    dupPtr->typePtr = &ksuid_ObjType;
+}
+
+static void ksuid_UpdateString(Tcl_Obj *objPtr) {
+    unsigned char timestamp_and_payload_bytes[TOTAL_BYTES];
+    memcpy(timestamp_and_payload_bytes, KSUID_OBJ_BYTES(objPtr), TOTAL_BYTES);
+
+    objPtr->bytes = (char *) ckalloc(PAD_TO_LENGTH + 1);
+    base62_encode_ksuid(timestamp_and_payload_bytes, (unsigned char *) objPtr->bytes);
+    objPtr->bytes[PAD_TO_LENGTH] = '\0';
+    objPtr->length = PAD_TO_LENGTH;
+}
+
+static int ksuid_SetFromAny(Tcl_Interp *interp, Tcl_Obj *objPtr) {
+    Tcl_Size length;
+    auto ksuid = (const unsigned char *) Tcl_GetStringFromObj(objPtr, &length);
+    if (length != PAD_TO_LENGTH) {
+        if (interp) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid ksuid", -1));
+        }
+        return TCL_ERROR;
+    }
+
+    unsigned char timestamp_and_payload_bytes[TOTAL_BYTES];
+    if (TCL_OK != base62_decode(ksuid, timestamp_and_payload_bytes)) {
+        if (interp) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid base62", -1));
+        }
+        return TCL_ERROR;
+    }
+
+    auto bytes = (unsigned char *) ckalloc(TOTAL_BYTES);
+    memcpy(bytes, timestamp_and_payload_bytes, TOTAL_BYTES);
+
+    if (objPtr->typePtr && objPtr->typePtr->freeIntRepProc) {
+        objPtr->typePtr->freeIntRepProc(objPtr);
+    }
+    objPtr->internalRep.twoPtrValue.ptr1 = bytes;
+    objPtr->typePtr = &ksuid_ObjType;
+    return TCL_OK;
+}
+
+// Returns the 20 bytes of the ksuid held by objPtr, converting it if needed.
+// The pointer is owned by objPtr and only valid while objPtr keeps its type.
+static int ksuid_GetBytesFromObj(Tcl_Interp *interp, Tcl_Obj *objPtr, const unsigned char **bytesPtr) {
+    if (objPtr->typePtr != &ksuid_ObjType) {
+        if (TCL_OK != Tcl_ConvertToType(interp, objPtr, &ksuid_ObjType)) {
+            return TCL_ERROR;
+        }
+    }
+    *bytesPtr = KSUID_OBJ_BYTES(objPtr);
+    return TCL_OK;
+}
+
+static Tcl_Obj *ksuid_NewKsuidObj(const unsigned char timestamp_and_payload_bytes[]) {
+    auto bytes = (unsigned char *) ckalloc(TOTAL_BYTES);
+    memcpy(bytes, timestamp_and_payload_bytes, TOTAL_BYTES);
+
+    Tcl_Obj *objPtr = Tcl_NewObj();
+    Tcl_InvalidateStringRep(objPtr);
+    objPtr->internalRep.twoPtrValue.ptr1 = bytes;
+    objPtr->typePtr = &ksuid_ObjType;
+    return objPtr;
+}
+
+// Same as ksuid_NewKsuidObj for a ksuid whose string form is already known
+static Tcl_Obj *ksuid_NewKsuidObjFromString(const unsigned char timestamp_and_payload_bytes[], const unsigned char ksuid[]) {
+    auto bytes = (unsigned char *) ckalloc(TOTAL_BYTES);
+    memcpy(bytes, timestamp_and_payload_bytes, TOTAL_BYTES);
+
+    Tcl_Obj *objPtr = Tcl_NewStringObj((const char *) ksuid, PAD_TO_LENGTH);
+    objPtr->internalRep.twoPtrValue.ptr1 = bytes;
+    objPtr->typePtr = &ksuid_ObjType;
+    return objPtr;
+}
+
 static int ksuid_ConcatTimestampAndPayload(Tcl_Interp *interp, const unsigned char timestamp_bytes[],
                                            const unsigned char payload_bytes[]) {
 
     // ---- Concatenate the timestamp and payload bytes ----
-    // Create a vector of size 20 to store the timestamp and payload bytes
     unsigned char timestamp_and_payload_bytes[TOTAL_BYTES];
-    // Copy the timestamp bytes to the vector
     std::copy(timestamp_bytes, timestamp_bytes + TIMESTAMP_BYTES, timestamp_and_payload_bytes);
-    // Copy the payload bytes to the vector
     std::copy(payload_bytes, payload_bytes + PAYLOAD_BYTES, timestamp_and_payload_bytes + TIMESTAMP_BYTES);
 
-    // ---- Base62 encode with fixed length ----
-    unsigned char base62[PAD_TO_LENGTH];
-    if (TCL_OK != base62_encode(timestamp_and_payload_bytes, TOTAL_BYTES, base62, PAD_TO_LENGTH)) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid base62", -1));
-        return TCL_ERROR;
+    // ---- The base62 string is generated lazily from the ksuid object ----
+    Tcl_SetObjResult(interp, ksuid_NewKsuidObj(timestamp_and_payload_bytes));
+    return TCL_OK;
+}
+
+static Tcl_WideInt ksuid_CurrentUnixNanos() {
+    auto since_epoch = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch).count();
+}
+
+// The coarse clock is only updated once per scheduler tick (a few
+// milliseconds), but reading it is a plain load from the vDSO page
+static Tcl_WideInt ksuid_CoarseUnixNanos() {
+#if defined(CLOCK_REALTIME_COARSE)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0) {
+        return (Tcl_WideInt) ts.tv_sec * 1000000000 + ts.tv_nsec;
     }
+#endif
+    return ksuid_CurrentUnixNanos();
+}
 
-    Tcl_SetObjResult(interp, Tcl_NewStringObj((const char *) base62, PAD_TO_LENGTH));
+// ---- Sub-second precision ----
+// The opt-in precisions store the fraction of the second big endian in the
+// leading bytes of the payload, right after the timestamp. The ksuid stays 20
+// bytes (27 characters) and sorts by time down to the chosen unit, at the
+// cost of that many random bits.
+
+typedef struct {
+    const char *name;
+    int fraction_bytes;
+    uint32_t nanos_per_unit;
+} ksuid_precision_t;
+
+static const ksuid_precision_t KSUID_PRECISIONS[] = {
+        {"seconds", 0, 1000000000},
+        {"millis",  2, 1000000},
+        {"micros",  3, 1000},
+        {"nanos",   4, 1},
+        {nullptr,   0, 0}
+};
+
+static int ksuid_GetPrecisionFromObj(Tcl_Interp *interp, Tcl_Obj *objPtr, const ksuid_precision_t **precisionPtr) {
+    int precisionIndex;
+    if (TCL_OK != Tcl_GetIndexFromObjStruct(interp, objPtr, KSUID_PRECISIONS, sizeof(ksuid_precision_t), "precision", 0,
+                                            &precisionIndex)) {
+        return TCL_ERROR;
+    }
+    *precisionPtr = &KSUID_PRECISIONS[precisionIndex];
     return TCL_OK;
 }
 
-static int ksuid_GenerateKsuidCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
-    DBG(fprintf(stderr, "GenerateCmd\n"));
-    CheckArgs(1, 1, 1, "");
+static void ksuid_FractionToBytes(const ksuid_precision_t *precisionPtr, uint32_t nanos, unsigned char payload_bytes[]) {
+    uint32_t fraction = nanos / precisionPtr->nanos_per_unit;
+    for (int i = precisionPtr->fraction_bytes - 1; i >= 0; i--) {
+        payload_bytes[i] = fraction & 0xFF;
+        fraction >>= 8;
+    }
+}
 
-    // ---- Generate the payload ----
-    // Create a random device and a mt19937 engine
-    std::random_device rd;
-    std::mt19937 mt(rd());
-    // Create a uniform_int_distribution object that generates unsigned char values between 0 and uint64_t max.
-    std::uniform_int_distribution<uint64_t> dist(0, std::numeric_limits<uint64_t>::max());
-    custom_uint128_t v = make_uint128(dist(mt), dist(mt));
-    unsigned char payload_bytes[PAYLOAD_BYTES];
-    uint128_to_bytes(v, payload_bytes);
+static uint32_t ksuid_FractionFromBytes(const ksuid_precision_t *precisionPtr, const unsigned char payload_bytes[]) {
+    uint32_t fraction = 0;
+    for (int i = 0; i < precisionPtr->fraction_bytes; i++) {
+        fraction = (fraction << 8) | payload_bytes[i];
+    }
+    return fraction;
+}
 
-    // ---- Generate the timestamp ----
-    // Get the current system time
-    auto time = std::chrono::system_clock::now();
-    // Get the duration since epoch
-    auto since_epoch = time.time_since_epoch();
-    // Convert the duration to milliseconds
-    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch);
-    // Get the count of milliseconds as an integer
-    unsigned int timestamp = millis.count() / 1000 - EPOCH;
+// ---- Layouts ----
+// The epoch and precision a ksuid is generated with. The byte layout itself is
+// fixed at compile time, only the meaning of the timestamp and of the leading
+// payload bytes varies.
 
-    // ---- Convert the timestamp to bytes ----
-    // Create a vector of size 4 to store the timestamp bytes
+typedef struct {
+    Tcl_WideInt epoch;
+    const ksuid_precision_t *precisionPtr;
+} ksuid_layout_t;
+
+static const ksuid_layout_t KSUID_DEFAULT_LAYOUT = {DEFAULT_EPOCH, &KSUID_PRECISIONS[0]};
+
+// Wipes the random generator of a thread when the thread (or the process) exits
+static void ksuid_ThreadExitHandler(ClientData unused) {
+    auto tsdPtr = (ThreadSpecificData *) Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
+    csprng_destroy(&tsdPtr->rng);
+    tsdPtr->initialized = 0;
+}
+
+static ThreadSpecificData *ksuid_GetThreadData() {
+    auto tsdPtr = (ThreadSpecificData *) Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
+    if (!tsdPtr->initialized) {
+        // the random generator seeds itself lazily on first use
+        Tcl_CreateThreadExitHandler(ksuid_ThreadExitHandler, nullptr);
+        tsdPtr->initialized = 1;
+    }
+    return tsdPtr;
+}
+
+// ---- Per-thread clock ----
+// Ksuids of seconds precision read the coarse clock, and the encoded
+// timestamp bytes are cached until the second (or the epoch) changes.
+// Sub-second precisions need the precise clock. Both readings go through
+// the same per-thread high-water mark, so when the wall clock steps back
+// (or the coarse clock lags behind a precise reading) the ksuids of a thread
+// stay at the latest time handed out instead of going back in time.
+
+static void ksuid_CurrentTime(ThreadSpecificData *tsdPtr, Tcl_WideInt epoch, const ksuid_precision_t *precisionPtr,
+                              unsigned char timestamp_bytes[], uint32_t *nanosPtr) {
+    Tcl_WideInt now = precisionPtr->fraction_bytes == 0 ? ksuid_CoarseUnixNanos() : ksuid_CurrentUnixNanos();
+    if (now < tsdPtr->clock_nanos) {
+        now = tsdPtr->clock_nanos;
+    }
+    tsdPtr->clock_nanos = now;
+
+    Tcl_WideInt seconds = now / 1000000000;
+    if (seconds != tsdPtr->cached_seconds || epoch != tsdPtr->cached_epoch) {
+        ksuid_TimestampToBytes((unsigned int) (seconds - epoch), tsdPtr->cached_timestamp_bytes);
+        tsdPtr->cached_seconds = seconds;
+        tsdPtr->cached_epoch = epoch;
+    }
+    memcpy(timestamp_bytes, tsdPtr->cached_timestamp_bytes, TIMESTAMP_BYTES);
+    *nanosPtr = (uint32_t) (now % 1000000000);
+}
+
+static int ksuid_Generate(Tcl_Interp *interp, const ksuid_layout_t *layoutPtr) {
+    auto tsdPtr = ksuid_GetThreadData();
+
+    // ---- Generate the timestamp ----
     unsigned char timestamp_bytes[TIMESTAMP_BYTES];
-    ksuid_TimestampToBytes(timestamp, timestamp_bytes);
+    uint32_t nanos;
+    ksuid_CurrentTime(tsdPtr, layoutPtr->epoch, layoutPtr->precisionPtr, timestamp_bytes, &nanos);
+
+    // ---- Take a pre-generated ksuid of this second from the pool ----
+    // The pool only holds ksuids of the default layout, see ::ksuid::pool
+    if (layoutPtr->epoch == DEFAULT_EPOCH && layoutPtr->precisionPtr->fraction_bytes == 0) {
+        pool_entry_t entry;
+        if (TCL_OK == pool_pop(ksuid_BytesToTimestamp(timestamp_bytes), &entry)) {
+            Tcl_SetObjResult(interp, ksuid_NewKsuidObjFromString(entry.bytes, entry.ksuid));
+            return TCL_OK;
+        }
+    }
+
+    // ---- Generate the payload ----
+    // Draw the random bytes from this thread's buffered generator
+    unsigned char payload_bytes[PAYLOAD_BYTES];
+    if (TCL_OK != csprng_bytes(&tsdPtr->rng, payload_bytes, PAYLOAD_BYTES)) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("failed to generate random payload", -1));
+        return TCL_ERROR;
+    }
+    ksuid_FractionToBytes(layoutPtr->precisionPtr, nanos, payload_bytes);
 
     return ksuid_ConcatTimestampAndPayload(interp, timestamp_bytes, payload_bytes);
 }
 
-static int ksuid_KsuidToParts(Tcl_Interp *interp, const unsigned char * ksuid, Tcl_Obj **resultPtr) {
+static int ksuid_GenerateKsuidCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "GenerateCmd\n"));
+    CheckArgs(1, 3, 1, "?-precision precision?");
+
+    ksuid_layout_t layout = KSUID_DEFAULT_LAYOUT;
+    if (objc > 1) {
+        static const char *options[] = {"-precision", nullptr};
+        int optionIndex;
+        if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[1], options, "option", 0, &optionIndex)) {
+            return TCL_ERROR;
+        }
+        if (objc != 3) {
+            Tcl_WrongNumArgs(interp, 1, objv, "?-precision precision?");
+            return TCL_ERROR;
+        }
+        if (TCL_OK != ksuid_GetPrecisionFromObj(interp, objv[2], &layout.precisionPtr)) {
+            return TCL_ERROR;
+        }
+    }
+
+    return ksuid_Generate(interp, &layout);
+}
+
+static int ksuid_GenerateManyCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "GenerateManyCmd\n"));
+    CheckArgs(2, 3, 1, "count ?-sorted?");
+
+    Tcl_Size count;
+    if (TCL_OK != Tcl_GetSizeIntFromObj(interp, objv[1], &count)) {
+        return TCL_ERROR;
+    }
+    if (count < 0) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("count must be non-negative", -1));
+        return TCL_ERROR;
+    }
+    if (count > TCL_SIZE_MAX / PAD_TO_LENGTH) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("count too large", -1));
+        return TCL_ERROR;
+    }
+
+    int sorted = 0;
+    if (objc == 3) {
+        static const char *options[] = {"-sorted", nullptr};
+        int optionIndex;
+        if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[2], options, "option", 0, &optionIndex)) {
+            return TCL_ERROR;
+        }
+        sorted = 1;
+    }
+
+    // ---- Allocate the scratch buffers ----
+    // A count that does not fit in memory is an error, not an abort
+    auto payloads = (std::array<unsigned char, 16> *) attemptckalloc(count * sizeof(std::array<unsigned char, 16>) + 1);
+    auto base62 = (unsigned char *) attemptckalloc((size_t) count * PAD_TO_LENGTH + 1);
+    auto elements = (Tcl_Obj **) attemptckalloc(count * sizeof(Tcl_Obj *) + 1);
+    if (payloads == nullptr || base62 == nullptr || elements == nullptr) {
+        ckfree((char *) payloads);
+        ckfree((char *) base62);
+        ckfree((char *) elements);
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("not enough memory", -1));
+        return TCL_ERROR;
+    }
 
-    // ---- Base62 decode ----
+    // ---- Read the clock once per batch ----
+    auto tsdPtr = ksuid_GetThreadData();
     unsigned char timestamp_and_payload_bytes[TOTAL_BYTES];
-    if (TCL_OK != base62_decode(ksuid, timestamp_and_payload_bytes)) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid base62", -1));
+    uint32_t nanos;
+    ksuid_CurrentTime(tsdPtr, DEFAULT_EPOCH, &KSUID_PRECISIONS[0], timestamp_and_payload_bytes, &nanos);
+
+    // ---- Take what the pool holds for this second ----
+    // Pooled ksuids come with their string form
+    uint32_t timestamp = ksuid_BytesToTimestamp(timestamp_and_payload_bytes);
+    Tcl_Size pooled = 0;
+    pool_entry_t entry;
+    while (pooled < count && TCL_OK == pool_pop(timestamp, &entry)) {
+        memcpy(payloads[pooled].data(), entry.bytes + TIMESTAMP_BYTES, PAYLOAD_BYTES);
+        memcpy(base62 + (size_t) pooled * PAD_TO_LENGTH, entry.ksuid, PAD_TO_LENGTH);
+        pooled++;
+    }
+
+    // ---- Generate the remaining payloads with a single draw ----
+    if (pooled < count
+        && TCL_OK != csprng_bytes(&tsdPtr->rng, payloads[pooled].data(), (size_t) (count - pooled) * PAYLOAD_BYTES)) {
+        ckfree((char *) payloads);
+        ckfree((char *) base62);
+        ckfree((char *) elements);
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("failed to generate random payload", -1));
         return TCL_ERROR;
     }
 
+    // all ksuids of a batch share the timestamp, so ordering the payloads orders the ksuids
+    if (sorted) {
+        std::sort(payloads, payloads + count);
+        pooled = 0; // the string forms no longer line up with the payloads
+    }
+
+    // ---- Encode into one preallocated buffer ----
+    // The results carry the ksuid internal rep, like the ksuids of
+    // ::ksuid::generate_ksuid, so later commands do not decode them again
+    for (Tcl_Size i = 0; i < count; i++) {
+        unsigned char *ksuid = base62 + (size_t) i * PAD_TO_LENGTH;
+        memcpy(timestamp_and_payload_bytes + TIMESTAMP_BYTES, payloads[i].data(), PAYLOAD_BYTES);
+        if (i >= pooled) {
+            base62_encode_ksuid(timestamp_and_payload_bytes, ksuid);
+        }
+        elements[i] = ksuid_NewKsuidObjFromString(timestamp_and_payload_bytes, ksuid);
+    }
+    Tcl_SetObjResult(interp, Tcl_NewListObj(count, elements));
+
+    ckfree((char *) payloads);
+    ckfree((char *) base62);
+    ckfree((char *) elements);
+    return TCL_OK;
+}
+
+static int ksuid_KsuidToParts(Tcl_Interp *interp, ksuid_interp_data_t *interpDataPtr,
+                              const unsigned char timestamp_and_payload_bytes[],
+                              const ksuid_precision_t *precisionPtr, Tcl_Obj **resultPtr) {
+
     // ---- Convert the timestamp bytes to a long ----
     unsigned int timestamp = ksuid_BytesToTimestamp(timestamp_and_payload_bytes);
 //    timestamp += EPOCH;
 //    timestamp *= 1000;
 
     // ---- Convert the payload bytes to a hex string ----
-    std::string hex;
+    char hex[PAYLOAD_BYTES * 2];
     hex_encode(timestamp_and_payload_bytes + TIMESTAMP_BYTES, PAYLOAD_BYTES, hex);
 
     // ---- Return the timestamp and payload ----
     Tcl_Obj *dictPtr = Tcl_NewDictObj();
 //    Tcl_DictObjPut(interp, dictPtr, Tcl_NewStringObj("epoch", -1), Tcl_NewLongObj(EPOCH));
-    Tcl_DictObjPut(interp, dictPtr, Tcl_NewStringObj("timestamp", -1), Tcl_NewLongObj(timestamp));
-    Tcl_DictObjPut(interp, dictPtr, Tcl_NewStringObj("payload", -1), Tcl_NewStringObj(hex.c_str(), hex.length()));
+    Tcl_DictObjPut(interp, dictPtr, interpDataPtr->timestampKeyPtr, Tcl_NewLongObj(timestamp));
+    Tcl_DictObjPut(interp, dictPtr, interpDataPtr->payloadKeyPtr, Tcl_NewStringObj(hex, PAYLOAD_BYTES * 2));
+    if (precisionPtr->fraction_bytes > 0) {
+        uint32_t fraction = ksuid_FractionFromBytes(precisionPtr, timestamp_and_payload_bytes + TIMESTAMP_BYTES);
+        Tcl_DictObjPut(interp, dictPtr, interpDataPtr->precisionKeyPtrs[precisionPtr - KSUID_PRECISIONS],
+                       Tcl_NewWideIntObj(fraction));
+    }
     *resultPtr = dictPtr;
     return TCL_OK;
 }
 
 static int ksuid_KsuidToPartsCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
     DBG(fprintf(stderr, "KsuidToPartsCmd\n"));
-    CheckArgs(2, 2, 1, "ksuid");
+    CheckArgs(2, 4, 1, "ksuid ?-precision precision?");
+
+    const ksuid_precision_t *precisionPtr = &KSUID_PRECISIONS[0];
+    if (objc > 2) {
+        static const char *options[] = {"-precision", nullptr};
+        int optionIndex;
+        if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[2], options, "option", 0, &optionIndex)) {
+            return TCL_ERROR;
+        }
+        if (objc != 4) {
+            Tcl_WrongNumArgs(interp, 1, objv, "ksuid ?-precision precision?");
+            return TCL_ERROR;
+        }
+        if (TCL_OK != ksuid_GetPrecisionFromObj(interp, objv[3], &precisionPtr)) {
+            return TCL_ERROR;
+        }
+    }
 
     // ---- Convert the ksuid to bytes ----
-
-    // Get the ksuid from the arguments
-    Tcl_Size length;
-    auto ksuid = (const unsigned char *) Tcl_GetStringFromObj(objv[1], &length);
-    if (length != PAD_TO_LENGTH) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid ksuid", -1));
+    const unsigned char *ksuid_bytes;
+    if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[1], &ksuid_bytes)) {
         return TCL_ERROR;
     }
 
+    auto interpDataPtr = (ksuid_interp_data_t *) clientData;
     Tcl_Obj *dictPtr;
-    if (TCL_OK != ksuid_KsuidToParts(interp, ksuid, &dictPtr)) {
+    if (TCL_OK != ksuid_KsuidToParts(interp, interpDataPtr, ksuid_bytes, precisionPtr, &dictPtr)) {
         return TCL_ERROR;
     }
     Tcl_SetObjResult(interp, dictPtr);
     return TCL_OK;
 }
 
+static int ksuid_PartsManyCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "PartsManyCmd\n"));
+    CheckArgs(2, 4, 1, "list ?-timestamps-only? ?-binary?");
+
+    int timestamps_only = 0;
+    int binary = 0;
+    static const char *options[] = {"-binary", "-timestamps-only", nullptr};
+    enum option {
+        OPTION_BINARY, OPTION_TIMESTAMPS_ONLY
+    };
+    for (int i = 2; i < objc; i++) {
+        int optionIndex;
+        if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, &optionIndex)) {
+            return TCL_ERROR;
+        }
+        switch ((enum option) optionIndex) {
+            case OPTION_BINARY:
+                binary = 1;
+                break;
+            case OPTION_TIMESTAMPS_ONLY:
+                timestamps_only = 1;
+                break;
+        }
+    }
+
+    Tcl_Size count;
+    Tcl_Obj **elements;
+    if (TCL_OK != Tcl_ListObjGetElements(interp, objv[1], &count, &elements)) {
+        return TCL_ERROR;
+    }
+
+    // ---- Decode every element once ----
+    std::vector<std::array<unsigned char, 20>> keys(count);
+    for (Tcl_Size i = 0; i < count; i++) {
+        const unsigned char *ksuid_bytes;
+        if (TCL_OK != ksuid_GetBytesFromObj(interp, elements[i], &ksuid_bytes)) {
+            return TCL_ERROR;
+        }
+        memcpy(keys[i].data(), ksuid_bytes, TOTAL_BYTES);
+    }
+
+    // ---- Build the columns ----
+    auto interpDataPtr = (ksuid_interp_data_t *) clientData;
+    Tcl_Obj *dictPtr = Tcl_NewDictObj();
+
+    std::vector<Tcl_Obj *> column(count);
+    for (Tcl_Size i = 0; i < count; i++) {
+        column[i] = Tcl_NewWideIntObj(ksuid_BytesToTimestamp(keys[i].data()));
+    }
+    Tcl_DictObjPut(interp, dictPtr, interpDataPtr->timestampKeyPtr, Tcl_NewListObj(count, column.data()));
+
+    if (binary && !timestamps_only) {
+        Tcl_Obj *payloadsPtr = Tcl_NewByteArrayObj(nullptr, 0);
+        unsigned char *payload_bytes = Tcl_SetByteArrayLength(payloadsPtr, count * PAYLOAD_BYTES);
+        for (Tcl_Size i = 0; i < count; i++) {
+            memcpy(payload_bytes + i * PAYLOAD_BYTES, keys[i].data() + TIMESTAMP_BYTES, PAYLOAD_BYTES);
+        }
+        Tcl_DictObjPut(interp, dictPtr, interpDataPtr->payloadKeyPtr, payloadsPtr);
+    } else if (!timestamps_only) {
+        for (Tcl_Size i = 0; i < count; i++) {
+            char hex[PAYLOAD_BYTES * 2];
+            hex_encode(keys[i].data() + TIMESTAMP_BYTES, PAYLOAD_BYTES, hex);
+            column[i] = Tcl_NewStringObj(hex, PAYLOAD_BYTES * 2);
+        }
+        Tcl_DictObjPut(interp, dictPtr, interpDataPtr->payloadKeyPtr, Tcl_NewListObj(count, column.data()));
+    }
+
+    Tcl_SetObjResult(interp, dictPtr);
+    return TCL_OK;
+}
+
+// Returns the bytes of a value that is only a byte array, i.e. has no string
+// rep, and nullptr for anything else. Tcl 9 tells byte sequences apart with
+// Tcl_GetBytesFromObj, 8.6 has no such call and the internal rep must be
+// its "bytearray" type.
+static unsigned char *ksuid_GetPureBytes(Tcl_Obj *objPtr, Tcl_Size *lengthPtr) {
+    if (objPtr->bytes != nullptr) {
+        return nullptr;
+    }
+#if TCL_MAJOR_VERSION >= 9
+    return Tcl_GetBytesFromObj(nullptr, objPtr, lengthPtr);
+#else
+    if (objPtr->typePtr != ksuid_ByteArrayObjType) {
+        return nullptr;
+    }
+    return Tcl_GetByteArrayFromObj(objPtr, lengthPtr);
+#endif
+}
+
 static int ksuid_PartsToKsuidCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
     DBG(fprintf(stderr, "PartsToKsuidCmd\n"));
     CheckArgs(2, 2, 1, "parts_dict");
 
     // ---- Get the timestamp and payload from the dictionary ----
+    auto interpDataPtr = (ksuid_interp_data_t *) clientData;
     Tcl_Obj *timestampPtr;
     Tcl_Obj *payloadPtr;
-    if (TCL_OK != Tcl_DictObjGet(interp, objv[1], Tcl_NewStringObj("timestamp", -1), &timestampPtr)) {
+    if (TCL_OK != Tcl_DictObjGet(interp, objv[1], interpDataPtr->timestampKeyPtr, &timestampPtr)) {
+        return TCL_ERROR;
+    }
+    if (timestampPtr == nullptr) {
         Tcl_SetObjResult(interp, Tcl_NewStringObj("missing timestamp", -1));
         return TCL_ERROR;
     }
-    if (TCL_OK != Tcl_DictObjGet(interp, objv[1], Tcl_NewStringObj("payload", -1), &payloadPtr)) {
+    if (TCL_OK != Tcl_DictObjGet(interp, objv[1], interpDataPtr->payloadKeyPtr, &payloadPtr)) {
+        return TCL_ERROR;
+    }
+    if (payloadPtr == nullptr) {
         Tcl_SetObjResult(interp, Tcl_NewStringObj("missing payload", -1));
         return TCL_ERROR;
     }
@@ -230,184 +721,1657 @@ static int ksuid_PartsToKsuidCmd(ClientData clientData, Tcl_Interp *interp, int
     ksuid_TimestampToBytes(timestamp, timestamp_bytes);
 
     // ---- Convert the payload to bytes ----
-    Tcl_Size payload_length;
-    auto payload = Tcl_GetStringFromObj(payloadPtr, &payload_length);
+    // A pure 16-byte bytes object is taken as is, anything else must be hex
     unsigned char payload_bytes[PAYLOAD_BYTES];
-    if (TCL_OK != hex_decode(payload, payload_length, payload_bytes, PAYLOAD_BYTES)) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid hex", -1));
-        return TCL_ERROR;
+    Tcl_Size payload_length;
+    auto bytes = ksuid_GetPureBytes(payloadPtr, &payload_length);
+    if (bytes != nullptr) {
+        if (payload_length != PAYLOAD_BYTES) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid payload", -1));
+            return TCL_ERROR;
+        }
+        memcpy(payload_bytes, bytes, PAYLOAD_BYTES);
+    } else {
+        auto payload = Tcl_GetStringFromObj(payloadPtr, &payload_length);
+        if (payload_length != PAYLOAD_BYTES * 2 || TCL_OK != hex_decode(payload, payload_length, payload_bytes)) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid hex", -1));
+            return TCL_ERROR;
+        }
     }
 
     return ksuid_ConcatTimestampAndPayload(interp, timestamp_bytes, payload_bytes);
 }
 
 
-static int ksuid_KsuidFromTimestampAndPayload(Tcl_Interp *pInterp, long t, custom_uint128_t v) {
-
-    // ---- Convert the timestamp to bytes ----
-    // Create a vector of size 4 to store the timestamp bytes
-    unsigned char timestamp_bytes[TIMESTAMP_BYTES];
-    ksuid_TimestampToBytes(t, timestamp_bytes);
+// The 20 bytes of a ksuid are a big endian 160-bit integer: the timestamp
+// holds the top 32 bits and the payload the low 128 bits. Both helpers wrap
+// around, so the next of the maximum ksuid is the minimum one.
 
-    // ---- Convert the payload to bytes ----
-    unsigned char payload_bytes[PAYLOAD_BYTES];
-    uint128_to_bytes(v, payload_bytes);
+static void ksuid_AddToBytes(unsigned char timestamp_and_payload_bytes[], uint64_t n) {
+    unsigned int timestamp = ksuid_BytesToTimestamp(timestamp_and_payload_bytes);
+    auto u = make_uint128_from_bytes(timestamp_and_payload_bytes + TIMESTAMP_BYTES);
+    custom_uint128_t v;
+    if (add128_overflow(u, make_uint128(n, 0), &v)) { // carry into the timestamp
+        timestamp++;
+    }
 
-    return ksuid_ConcatTimestampAndPayload(pInterp, timestamp_bytes, payload_bytes);
+    ksuid_TimestampToBytes(timestamp, timestamp_and_payload_bytes);
+    uint128_to_bytes(v, timestamp_and_payload_bytes + TIMESTAMP_BYTES);
 }
 
-static int ksuid_NextKsuidCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
-    DBG(fprintf(stderr, "NextKsuidCmd\n"));
-    CheckArgs(2, 2, 1, "ksuid");
-
-    // Get the ksuid from the arguments
-    Tcl_Size length;
-    auto ksuid = (const unsigned char *) Tcl_GetStringFromObj(objv[1], &length);
-    if (length != PAD_TO_LENGTH) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid ksuid", -1));
-        return TCL_ERROR;
+static void ksuid_SubtractFromBytes(unsigned char timestamp_and_payload_bytes[], uint64_t n) {
+    unsigned int timestamp = ksuid_BytesToTimestamp(timestamp_and_payload_bytes);
+    auto u = make_uint128_from_bytes(timestamp_and_payload_bytes + TIMESTAMP_BYTES);
+    custom_uint128_t v;
+    if (sub128_overflow(u, make_uint128(n, 0), &v)) { // borrow from the timestamp
+        timestamp--;
     }
 
-    Tcl_Obj *dictPtr;
-    if (TCL_OK != ksuid_KsuidToParts(interp, ksuid, &dictPtr)) {
-        return TCL_ERROR;
+    ksuid_TimestampToBytes(timestamp, timestamp_and_payload_bytes);
+    uint128_to_bytes(v, timestamp_and_payload_bytes + TIMESTAMP_BYTES);
+}
+
+static int ksuid_GetStepFromArgs(Tcl_Interp *interp, int objc, Tcl_Obj *const objv[], uint64_t *stepPtr) {
+    if (objc < 3) {
+        *stepPtr = 1;
+        return TCL_OK;
     }
 
-    Tcl_Obj *timestampPtr;
-    if (TCL_OK != Tcl_DictObjGet(interp, dictPtr, Tcl_NewStringObj("timestamp", -1), &timestampPtr)) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("missing timestamp", -1));
+    Tcl_WideInt step;
+    if (TCL_OK != Tcl_GetWideIntFromObj(interp, objv[2], &step)) {
         return TCL_ERROR;
     }
-    long timestamp;
-    if (TCL_OK != Tcl_GetLongFromObj(interp, timestampPtr, &timestamp)) {
+    if (step < 0) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("step must be non-negative", -1));
         return TCL_ERROR;
     }
+    *stepPtr = (uint64_t) step;
+    return TCL_OK;
+}
 
-    unsigned char timestamp_bytes[TIMESTAMP_BYTES];
-    ksuid_TimestampToBytes(timestamp, timestamp_bytes);
+static int ksuid_NextKsuidCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "NextKsuidCmd\n"));
+    CheckArgs(2, 3, 1, "ksuid ?n?");
 
-    Tcl_Obj *payloadPtr;
-    if (TCL_OK != Tcl_DictObjGet(interp, dictPtr, Tcl_NewStringObj("payload", -1), &payloadPtr)) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("missing payload", -1));
+    // Copy the bytes before reading the step, which may shimmer the same object
+    const unsigned char *ksuid_bytes;
+    if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[1], &ksuid_bytes)) {
         return TCL_ERROR;
     }
-    Tcl_Size payload_length;
-    auto payload = Tcl_GetStringFromObj(payloadPtr, &payload_length);
-    unsigned char payload_bytes[PAYLOAD_BYTES];
-    if (TCL_OK != hex_decode(payload, payload_length, payload_bytes, PAYLOAD_BYTES)) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid hex", -1));
+    unsigned char timestamp_and_payload_bytes[TOTAL_BYTES];
+    memcpy(timestamp_and_payload_bytes, ksuid_bytes, TOTAL_BYTES);
+
+    uint64_t step;
+    if (TCL_OK != ksuid_GetStepFromArgs(interp, objc, objv, &step)) {
         return TCL_ERROR;
     }
 
-    auto zero = make_uint128(0, 0);
-
-	auto t = timestamp;
-	auto u = make_uint128_from_bytes(payload_bytes);
-	auto v = incr128(u);
-
-	if (0 == cmp128(v, zero)) { // overflow
-		t++;
-	}
-
-    return ksuid_KsuidFromTimestampAndPayload(interp, t, v);
+    ksuid_AddToBytes(timestamp_and_payload_bytes, step);
+    Tcl_SetObjResult(interp, ksuid_NewKsuidObj(timestamp_and_payload_bytes));
+    return TCL_OK;
 }
 
 static int ksuid_PrevKsuidCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
     DBG(fprintf(stderr, "PrevKsuidCmd\n"));
-    CheckArgs(2, 2, 1, "ksuid");
+    CheckArgs(2, 3, 1, "ksuid ?n?");
 
-    // Get the ksuid from the arguments
-    Tcl_Size length;
-    auto ksuid = (const unsigned char *) Tcl_GetStringFromObj(objv[1], &length);
-    if (length != PAD_TO_LENGTH) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid ksuid", -1));
+    // Copy the bytes before reading the step, which may shimmer the same object
+    const unsigned char *ksuid_bytes;
+    if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[1], &ksuid_bytes)) {
         return TCL_ERROR;
     }
+    unsigned char timestamp_and_payload_bytes[TOTAL_BYTES];
+    memcpy(timestamp_and_payload_bytes, ksuid_bytes, TOTAL_BYTES);
 
-    Tcl_Obj *dictPtr;
-    if (TCL_OK != ksuid_KsuidToParts(interp, ksuid, &dictPtr)) {
+    uint64_t step;
+    if (TCL_OK != ksuid_GetStepFromArgs(interp, objc, objv, &step)) {
         return TCL_ERROR;
     }
 
-    Tcl_Obj *timestampPtr;
-    if (TCL_OK != Tcl_DictObjGet(interp, dictPtr, Tcl_NewStringObj("timestamp", -1), &timestampPtr)) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("missing timestamp", -1));
-        return TCL_ERROR;
-    }
-    long timestamp;
-    if (TCL_OK != Tcl_GetLongFromObj(interp, timestampPtr, &timestamp)) {
-        return TCL_ERROR;
-    }
+    ksuid_SubtractFromBytes(timestamp_and_payload_bytes, step);
+    Tcl_SetObjResult(interp, ksuid_NewKsuidObj(timestamp_and_payload_bytes));
+    return TCL_OK;
+}
 
-    unsigned char timestamp_bytes[TIMESTAMP_BYTES];
-    ksuid_TimestampToBytes(timestamp, timestamp_bytes);
+// ---- 160-bit arithmetic ----
+// add, diff and split work on the whole ksuid as a 160-bit number: the
+// timestamp is the top 32 bits, the payload the low 128 bits handled by the
+// uint128 helpers. Multiplication and division only ever involve small
+// factors, so they run over five 32-bit limbs.
 
-    Tcl_Obj *payloadPtr;
-    if (TCL_OK != Tcl_DictObjGet(interp, dictPtr, Tcl_NewStringObj("payload", -1), &payloadPtr)) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("missing payload", -1));
-        return TCL_ERROR;
-    }
-    Tcl_Size payload_length;
-    auto payload = Tcl_GetStringFromObj(payloadPtr, &payload_length);
-    unsigned char payload_bytes[PAYLOAD_BYTES];
-    if (TCL_OK != hex_decode(payload, payload_length, payload_bytes, PAYLOAD_BYTES)) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid hex", -1));
-        return TCL_ERROR;
-    }
+typedef struct {
+    uint32_t hi;
+    custom_uint128_t lo;
+} ksuid_uint160_t;
 
-    auto max = make_uint128(std::numeric_limits<uint64_t>::max(), std::numeric_limits<uint64_t>::max());
+static ksuid_uint160_t ksuid_Uint160FromBytes(const unsigned char timestamp_and_payload_bytes[]) {
+    return ksuid_uint160_t{ksuid_BytesToTimestamp(timestamp_and_payload_bytes),
+                           make_uint128_from_bytes(timestamp_and_payload_bytes + TIMESTAMP_BYTES)};
+}
 
-    auto t = timestamp;
-    auto u = make_uint128_from_bytes(payload_bytes);
-    auto v = decr128(u);
+static void ksuid_Uint160ToBytes(const ksuid_uint160_t &x, unsigned char timestamp_and_payload_bytes[]) {
+    ksuid_TimestampToBytes(x.hi, timestamp_and_payload_bytes);
+    uint128_to_bytes(x.lo, timestamp_and_payload_bytes + TIMESTAMP_BYTES);
+}
 
-    if (0 == cmp128(v, max)) { // overflow
-        t--;
-    }
+// Both return 1 if the result wrapped around modulo 2^160
+static int ksuid_Add160(const ksuid_uint160_t &x, const ksuid_uint160_t &y, ksuid_uint160_t *resultPtr) {
+    uint64_t hi = (uint64_t) x.hi + y.hi + add128_overflow(x.lo, y.lo, &resultPtr->lo);
+    resultPtr->hi = (uint32_t) hi;
+    return hi > UINT32_MAX;
+}
 
-    return ksuid_KsuidFromTimestampAndPayload(interp, t, v);
+static int ksuid_Sub160(const ksuid_uint160_t &x, const ksuid_uint160_t &y, ksuid_uint160_t *resultPtr) {
+    uint64_t borrow = sub128_overflow(x.lo, y.lo, &resultPtr->lo);
+    resultPtr->hi = x.hi - y.hi - (uint32_t) borrow;
+    return x.hi < y.hi + borrow;
 }
 
-static int ksuid_HexEncodeCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
-    DBG(fprintf(stderr, "HexEncodeCmd\n"));
-    CheckArgs(2, 2, 1, "bytes");
+static int ksuid_Cmp160(const ksuid_uint160_t &x, const ksuid_uint160_t &y) {
+    return x.hi != y.hi ? (x.hi < y.hi ? -1 : 1) : cmp128(x.lo, y.lo);
+}
 
-    Tcl_Size length;
-    auto bytes = Tcl_GetByteArrayFromObj(objv[1], &length);
-    std::string hex;
-    if (TCL_OK != hex_encode(bytes, length, hex)) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid hex", -1));
-        return TCL_ERROR;
-    }
+static void ksuid_Uint160ToLimbs(const ksuid_uint160_t &x, uint32_t limbs[5]) {
+    limbs[0] = x.hi;
+    limbs[1] = (uint32_t) (x.lo.hi >> 32);
+    limbs[2] = (uint32_t) x.lo.hi;
+    limbs[3] = (uint32_t) (x.lo.lo >> 32);
+    limbs[4] = (uint32_t) x.lo.lo;
+}
 
-    Tcl_SetObjResult(interp, Tcl_NewStringObj(hex.c_str(), hex.length()));
-    return TCL_OK;
+static ksuid_uint160_t ksuid_Uint160FromLimbs(const uint32_t limbs[5]) {
+    return ksuid_uint160_t{limbs[0], make_uint128(((uint64_t) limbs[3] << 32) | limbs[4],
+                                                  ((uint64_t) limbs[1] << 32) | limbs[2])};
 }
 
-static int ksuid_HexDecodeCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
-    DBG(fprintf(stderr, "HexDecodeCmd\n"));
-    CheckArgs(2, 2, 1, "hex_string");
+// Returns x * factor + addend and whether it overflowed 160 bits
+static int ksuid_MulAdd160(const ksuid_uint160_t &x, uint32_t factor, uint32_t addend, ksuid_uint160_t *resultPtr) {
+    uint32_t limbs[5];
+    ksuid_Uint160ToLimbs(x, limbs);
+    uint64_t carry = addend;
+    for (int i = 4; i >= 0; i--) {
+        uint64_t product = (uint64_t) limbs[i] * factor + carry;
+        limbs[i] = (uint32_t) product;
+        carry = product >> 32;
+    }
+    *resultPtr = ksuid_Uint160FromLimbs(limbs);
+    return carry != 0;
+}
 
-    Tcl_Size length;
-    auto hex = Tcl_GetStringFromObj(objv[1], &length);
-    unsigned char bytes[length / 2];
-    if (TCL_OK != hex_decode(hex, length, bytes, length / 2)) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid hex", -1));
-        return TCL_ERROR;
+// Returns x / divisor and stores the remainder
+static ksuid_uint160_t ksuid_DivMod160(const ksuid_uint160_t &x, uint32_t divisor, uint32_t *remainderPtr) {
+    uint32_t limbs[5];
+    ksuid_Uint160ToLimbs(x, limbs);
+    uint64_t remainder = 0;
+    for (int i = 0; i < 5; i++) {
+        uint64_t value = (remainder << 32) | limbs[i];
+        limbs[i] = (uint32_t) (value / divisor);
+        remainder = value % divisor;
     }
-    Tcl_SetObjResult(interp, Tcl_NewByteArrayObj(bytes, length/2));
-    return TCL_OK;
+    *remainderPtr = (uint32_t) remainder;
+    return ksuid_Uint160FromLimbs(limbs);
 }
 
-static void ksuid_ExitHandler(ClientData unused) {
+static int ksuid_IsZero160(const ksuid_uint160_t &x) {
+    return x.hi == 0 && x.lo.hi == 0 && x.lo.lo == 0;
 }
 
+// Parses a signed integer of up to 160 bits: wide integers directly, larger
+// ones from their decimal string
+static int ksuid_GetInt160FromObj(Tcl_Interp *interp, Tcl_Obj *objPtr, int *negativePtr, ksuid_uint160_t *magnitudePtr) {
+    Tcl_WideInt value;
+    if (TCL_OK == Tcl_GetWideIntFromObj(nullptr, objPtr, &value)) {
+        *negativePtr = value < 0;
+        // negate in unsigned arithmetic, -LLONG_MIN does not fit a Tcl_WideInt
+        uint64_t magnitude = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+        *magnitudePtr = ksuid_uint160_t{0, make_uint128(magnitude, 0)};
+        return TCL_OK;
+    }
 
-void ksuid_InitModule() {
-    if (!ksuid_ModuleInitialized) {
-        Tcl_CreateThreadExitHandler(ksuid_ExitHandler, nullptr);
-        ksuid_ModuleInitialized = 1;
+    Tcl_Size length;
+    auto str = Tcl_GetStringFromObj(objPtr, &length);
+    Tcl_Size i = 0;
+    while (i < length && isspace((unsigned char) str[i])) {
+        i++;
+    }
+    *negativePtr = 0;
+    if (i < length && (str[i] == '-' || str[i] == '+')) {
+        *negativePtr = str[i] == '-';
+        i++;
+    }
+    while (length > i && isspace((unsigned char) str[length - 1])) {
+        length--;
+    }
+    if (i == length) {
+        return Tcl_GetWideIntFromObj(interp, objPtr, &value);
+    }
+
+    ksuid_uint160_t magnitude = {0, make_uint128(0, 0)};
+    for (; i < length; i++) {
+        if (str[i] < '0' || str[i] > '9') {
+            // let Tcl produce its usual message
+            return Tcl_GetWideIntFromObj(interp, objPtr, &value);
+        }
+        if (ksuid_MulAdd160(magnitude, 10, str[i] - '0', &magnitude)) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj("integer out of range", -1));
+            return TCL_ERROR;
+        }
+    }
+    *magnitudePtr = magnitude;
+    return TCL_OK;
+}
+
+static Tcl_Obj *ksuid_NewInt160Obj(int negative, const ksuid_uint160_t &magnitude) {
+    if (magnitude.hi == 0 && magnitude.lo.hi == 0 && magnitude.lo.lo <= (uint64_t) LLONG_MAX) {
+        auto value = (Tcl_WideInt) magnitude.lo.lo;
+        return Tcl_NewWideIntObj(negative ? -value : value);
+    }
+
+    // 2^160 has 49 decimal digits
+    char digits[50];
+    int offset = sizeof(digits);
+    ksuid_uint160_t rest = magnitude;
+    do {
+        uint32_t digit;
+        rest = ksuid_DivMod160(rest, 10, &digit);
+        digits[--offset] = (char) ('0' + digit);
+    } while (!ksuid_IsZero160(rest));
+    if (negative) {
+        digits[--offset] = '-';
+    }
+    return Tcl_NewStringObj(digits + offset, sizeof(digits) - offset);
+}
+
+static int ksuid_AddCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "AddCmd\n"));
+    CheckArgs(3, 3, 1, "ksuid n");
+
+    const unsigned char *ksuid_bytes;
+    if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[1], &ksuid_bytes)) {
+        return TCL_ERROR;
+    }
+    auto x = ksuid_Uint160FromBytes(ksuid_bytes);
+
+    int negative;
+    ksuid_uint160_t n;
+    if (TCL_OK != ksuid_GetInt160FromObj(interp, objv[2], &negative, &n)) {
+        return TCL_ERROR;
+    }
+
+    // wraps around like next_ksuid and prev_ksuid
+    ksuid_uint160_t result;
+    if (negative) {
+        ksuid_Sub160(x, n, &result);
+    } else {
+        ksuid_Add160(x, n, &result);
+    }
+
+    unsigned char timestamp_and_payload_bytes[TOTAL_BYTES];
+    ksuid_Uint160ToBytes(result, timestamp_and_payload_bytes);
+    Tcl_SetObjResult(interp, ksuid_NewKsuidObj(timestamp_and_payload_bytes));
+    return TCL_OK;
+}
+
+static int ksuid_DiffCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "DiffCmd\n"));
+    CheckArgs(3, 3, 1, "ksuid1 ksuid2");
+
+    const unsigned char *ksuid_bytes;
+    if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[1], &ksuid_bytes)) {
+        return TCL_ERROR;
+    }
+    auto a = ksuid_Uint160FromBytes(ksuid_bytes);
+    if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[2], &ksuid_bytes)) {
+        return TCL_ERROR;
+    }
+    auto b = ksuid_Uint160FromBytes(ksuid_bytes);
+
+    ksuid_uint160_t magnitude;
+    int negative = ksuid_Sub160(a, b, &magnitude);
+    if (negative) {
+        ksuid_Sub160(b, a, &magnitude);
+    }
+    Tcl_SetObjResult(interp, ksuid_NewInt160Obj(negative, magnitude));
+    return TCL_OK;
+}
+
+static int ksuid_SplitCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "SplitCmd\n"));
+    CheckArgs(4, 4, 1, "lo hi shards");
+
+    const unsigned char *ksuid_bytes;
+    if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[1], &ksuid_bytes)) {
+        return TCL_ERROR;
+    }
+    auto lo = ksuid_Uint160FromBytes(ksuid_bytes);
+    if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[2], &ksuid_bytes)) {
+        return TCL_ERROR;
+    }
+    auto hi = ksuid_Uint160FromBytes(ksuid_bytes);
+
+    int shards;
+    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[3], &shards)) {
+        return TCL_ERROR;
+    }
+    if (shards <= 0) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("shards must be positive", -1));
+        return TCL_ERROR;
+    }
+    if (ksuid_Cmp160(lo, hi) > 0) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("lo must not be greater than hi", -1));
+        return TCL_ERROR;
+    }
+
+    // point i is lo + width * i / shards, computed as
+    // lo + quotient * i + remainder * i / shards so nothing overflows
+    ksuid_uint160_t width;
+    ksuid_Sub160(hi, lo, &width);
+    uint32_t remainder;
+    auto quotient = ksuid_DivMod160(width, shards, &remainder);
+
+    std::vector<Tcl_Obj *> points(shards + 1);
+    for (int i = 0; i <= shards; i++) {
+        ksuid_uint160_t offset;
+        ksuid_MulAdd160(quotient, i, (uint32_t) ((uint64_t) remainder * i / shards), &offset);
+        ksuid_uint160_t point;
+        ksuid_Add160(lo, offset, &point);
+
+        unsigned char timestamp_and_payload_bytes[TOTAL_BYTES];
+        ksuid_Uint160ToBytes(point, timestamp_and_payload_bytes);
+        points[i] = ksuid_NewKsuidObj(timestamp_and_payload_bytes);
+    }
+    Tcl_SetObjResult(interp, Tcl_NewListObj(shards + 1, points.data()));
+    return TCL_OK;
+}
+
+static int ksuid_CompareBytes(const unsigned char a[], const unsigned char b[]) {
+    // big endian bytes compare the same way as the 160-bit numbers they hold
+    int result = memcmp(a, b, TOTAL_BYTES);
+    return result < 0 ? -1 : (result > 0 ? 1 : 0);
+}
+
+static int ksuid_CompareCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "CompareCmd\n"));
+    CheckArgs(3, 3, 1, "ksuid1 ksuid2");
+
+    const unsigned char *ksuid_bytes;
+    if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[1], &ksuid_bytes)) {
+        return TCL_ERROR;
+    }
+    unsigned char a[TOTAL_BYTES];
+    memcpy(a, ksuid_bytes, TOTAL_BYTES);
+
+    if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[2], &ksuid_bytes)) {
+        return TCL_ERROR;
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(ksuid_CompareBytes(a, ksuid_bytes)));
+    return TCL_OK;
+}
+
+static int ksuid_SortCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "SortCmd\n"));
+    CheckArgs(2, 4, 1, "?-unique? ?-decreasing? list");
+
+    int unique = 0;
+    int decreasing = 0;
+    static const char *options[] = {"-decreasing", "-unique", nullptr};
+    enum option {
+        OPTION_DECREASING, OPTION_UNIQUE
+    };
+    for (int i = 1; i < objc - 1; i++) {
+        int optionIndex;
+        if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, &optionIndex)) {
+            return TCL_ERROR;
+        }
+        switch ((enum option) optionIndex) {
+            case OPTION_DECREASING:
+                decreasing = 1;
+                break;
+            case OPTION_UNIQUE:
+                unique = 1;
+                break;
+        }
+    }
+
+    Tcl_Size count;
+    Tcl_Obj **elements;
+    if (TCL_OK != Tcl_ListObjGetElements(interp, objv[objc - 1], &count, &elements)) {
+        return TCL_ERROR;
+    }
+
+    // ---- Decode every element once into a contiguous array of keys ----
+    // Strings are decoded in place instead of being converted to ksuid
+    // objects, which would allocate an internal rep per element. The objects
+    // and their strings are scattered over the heap, so on large lists this
+    // loop is bound by cache misses: the object sixteen elements ahead and
+    // the string eight elements ahead are prefetched.
+    std::vector<unsigned char> keys(count * TOTAL_BYTES);
+    for (Tcl_Size i = 0; i < count; i++) {
+        if (i + 16 < count) {
+            PREFETCH(elements[i + 16]);
+        }
+        if (i + 8 < count && elements[i + 8]->bytes != nullptr) {
+            PREFETCH(elements[i + 8]->bytes);
+        }
+        unsigned char *key = keys.data() + i * TOTAL_BYTES;
+        if (elements[i]->typePtr == &ksuid_ObjType) {
+            memcpy(key, KSUID_OBJ_BYTES(elements[i]), TOTAL_BYTES);
+            continue;
+        }
+        Tcl_Size length;
+        auto ksuid = (const unsigned char *) Tcl_GetStringFromObj(elements[i], &length);
+        if (length != PAD_TO_LENGTH) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid ksuid", -1));
+            return TCL_ERROR;
+        }
+        if (TCL_OK != base62_decode(ksuid, key)) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid base62", -1));
+            return TCL_ERROR;
+        }
+    }
+
+    std::vector<size_t> order(count);
+    if (TCL_OK != radix_sort(keys.data(), count, order.data())) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("not enough memory", -1));
+        return TCL_ERROR;
+    }
+
+    // ---- Return the original objects in their new order ----
+    // Equal ksuids stay in list order, -unique keeps the last one of them in
+    // either direction, like lsort -unique.
+    std::vector<Tcl_Obj *> sorted(count);
+    Tcl_Size sorted_count = 0;
+    for (Tcl_Size i = 0; i < count; i++) {
+        Tcl_Size position = decreasing ? count - 1 - i : i;
+        size_t index = order[position];
+        if (unique && position + 1 < count
+            && 0 == memcmp(keys.data() + index * TOTAL_BYTES, keys.data() + order[position + 1] * TOTAL_BYTES, TOTAL_BYTES)) {
+            continue;
+        }
+        sorted[sorted_count++] = elements[index];
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewListObj(sorted_count, sorted.data()));
+    return TCL_OK;
+}
+
+// ---- Binary form ----
+// The raw 20-byte ksuids, concatenated into a single bytes object, for
+// serializers that pack ids without creating a string object per id.
+
+static int ksuid_GenerateBinaryCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "GenerateBinaryCmd\n"));
+    CheckArgs(1, 2, 1, "?count?");
+
+    Tcl_Size count = 1;
+    if (objc == 2 && TCL_OK != Tcl_GetSizeIntFromObj(interp, objv[1], &count)) {
+        return TCL_ERROR;
+    }
+    if (count < 0) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("count must be non-negative", -1));
+        return TCL_ERROR;
+    }
+    if (count > TCL_SIZE_MAX / TOTAL_BYTES) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("count too large", -1));
+        return TCL_ERROR;
+    }
+
+    // ---- Read the clock once per batch ----
+    auto tsdPtr = ksuid_GetThreadData();
+    unsigned char timestamp_bytes[TIMESTAMP_BYTES];
+    uint32_t nanos;
+    ksuid_CurrentTime(tsdPtr, DEFAULT_EPOCH, &KSUID_PRECISIONS[0], timestamp_bytes, &nanos);
+
+    // ---- Generate straight into the storage of the result ----
+    Tcl_Obj *resultPtr = Tcl_NewByteArrayObj(nullptr, 0);
+    auto bytes = Tcl_SetByteArrayLength(resultPtr, count * TOTAL_BYTES);
+    for (Tcl_Size i = 0; i < count; i++) {
+        auto ksuid_bytes = bytes + i * TOTAL_BYTES;
+        memcpy(ksuid_bytes, timestamp_bytes, TIMESTAMP_BYTES);
+        if (TCL_OK != csprng_bytes(&tsdPtr->rng, ksuid_bytes + TIMESTAMP_BYTES, PAYLOAD_BYTES)) {
+            Tcl_DecrRefCount(resultPtr);
+            Tcl_SetObjResult(interp, Tcl_NewStringObj("failed to generate random payload", -1));
+            return TCL_ERROR;
+        }
+    }
+    Tcl_SetObjResult(interp, resultPtr);
+    return TCL_OK;
+}
+
+static int ksuid_EncodeBinaryCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "EncodeBinaryCmd\n"));
+    CheckArgs(2, 2, 1, "bytes");
+
+    Tcl_Size length;
+    auto bytes = Tcl_GetByteArrayFromObj(objv[1], &length);
+    if (length % TOTAL_BYTES != 0) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("length must be a multiple of 20", -1));
+        return TCL_ERROR;
+    }
+
+    // the string forms are generated lazily from the ksuid objects
+    Tcl_Size count = length / TOTAL_BYTES;
+    std::vector<Tcl_Obj *> elements(count);
+    for (Tcl_Size i = 0; i < count; i++) {
+        elements[i] = ksuid_NewKsuidObj(bytes + i * TOTAL_BYTES);
+    }
+    Tcl_SetObjResult(interp, Tcl_NewListObj(count, elements.data()));
+    return TCL_OK;
+}
+
+static int ksuid_DecodeBinaryCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "DecodeBinaryCmd\n"));
+    CheckArgs(2, 2, 1, "list");
+
+    Tcl_Size count;
+    Tcl_Obj **elements;
+    if (TCL_OK != Tcl_ListObjGetElements(interp, objv[1], &count, &elements)) {
+        return TCL_ERROR;
+    }
+    if (count > TCL_SIZE_MAX / TOTAL_BYTES) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("list too large", -1));
+        return TCL_ERROR;
+    }
+
+    Tcl_Obj *resultPtr = Tcl_NewByteArrayObj(nullptr, 0);
+    auto bytes = Tcl_SetByteArrayLength(resultPtr, count * TOTAL_BYTES);
+    for (Tcl_Size i = 0; i < count; i++) {
+        const unsigned char *ksuid_bytes;
+        if (TCL_OK != ksuid_GetBytesFromObj(interp, elements[i], &ksuid_bytes)) {
+            Tcl_DecrRefCount(resultPtr);
+            return TCL_ERROR;
+        }
+        memcpy(bytes + i * TOTAL_BYTES, ksuid_bytes, TOTAL_BYTES);
+    }
+    Tcl_SetObjResult(interp, resultPtr);
+    return TCL_OK;
+}
+
+// ---- Timestamps ----
+// Only the top 32 bits of a ksuid are needed, so values that are not yet of
+// the ksuid type go through the reduced-width base62_decode_timestamp and
+// keep their string type instead of being fully decoded.
+
+static int ksuid_GetTimestampFromKsuidObj(Tcl_Interp *interp, Tcl_Obj *objPtr, unsigned int *timestampPtr) {
+    if (objPtr->typePtr == &ksuid_ObjType) {
+        *timestampPtr = ksuid_BytesToTimestamp(KSUID_OBJ_BYTES(objPtr));
+        return TCL_OK;
+    }
+
+    Tcl_Size length;
+    auto ksuid = (const unsigned char *) Tcl_GetStringFromObj(objPtr, &length);
+    if (length != PAD_TO_LENGTH) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid ksuid", -1));
+        return TCL_ERROR;
+    }
+    uint32_t timestamp;
+    if (TCL_OK != base62_decode_timestamp(ksuid, &timestamp)) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid base62", -1));
+        return TCL_ERROR;
+    }
+    *timestampPtr = timestamp;
+    return TCL_OK;
+}
+
+typedef struct {
+    int unix_time;
+    int millis;
+    const ksuid_precision_t *precisionPtr;
+} ksuid_timestamp_options_t;
+
+static int ksuid_GetTimestampOptions(Tcl_Interp *interp, int objc, Tcl_Obj *const objv[],
+                                     ksuid_timestamp_options_t *optionsPtr) {
+    static const char *options[] = {"-millis", "-precision", "-unix", nullptr};
+    enum option {
+        OPTION_MILLIS, OPTION_PRECISION, OPTION_UNIX
+    };
+    optionsPtr->unix_time = 0;
+    optionsPtr->millis = 0;
+    optionsPtr->precisionPtr = &KSUID_PRECISIONS[0];
+    for (int i = 2; i < objc; i++) {
+        int optionIndex;
+        if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, &optionIndex)) {
+            return TCL_ERROR;
+        }
+        switch ((enum option) optionIndex) {
+            case OPTION_MILLIS:
+                optionsPtr->millis = 1;
+                break;
+            case OPTION_PRECISION:
+                if (i + 1 >= objc) {
+                    Tcl_SetObjResult(interp, Tcl_NewStringObj("missing value for -precision", -1));
+                    return TCL_ERROR;
+                }
+                if (TCL_OK != ksuid_GetPrecisionFromObj(interp, objv[++i], &optionsPtr->precisionPtr)) {
+                    return TCL_ERROR;
+                }
+                break;
+            case OPTION_UNIX:
+                optionsPtr->unix_time = 1;
+                break;
+        }
+    }
+    return TCL_OK;
+}
+
+// Milliseconds include the fraction of the second stored by a sub-second
+// precision, which needs the payload and therefore the full decode. All
+// other values only need the timestamp.
+static int ksuid_GetTimestampValue(Tcl_Interp *interp, Tcl_Obj *objPtr, const ksuid_timestamp_options_t *optionsPtr,
+                                   Tcl_WideInt *valuePtr) {
+    unsigned int timestamp;
+    Tcl_WideInt nanos = 0;
+    if (optionsPtr->millis && optionsPtr->precisionPtr->fraction_bytes > 0) {
+        const unsigned char *bytes;
+        if (TCL_OK != ksuid_GetBytesFromObj(interp, objPtr, &bytes)) {
+            return TCL_ERROR;
+        }
+        timestamp = ksuid_BytesToTimestamp(bytes);
+        nanos = (Tcl_WideInt) ksuid_FractionFromBytes(optionsPtr->precisionPtr, bytes + TIMESTAMP_BYTES)
+                * optionsPtr->precisionPtr->nanos_per_unit;
+    } else if (TCL_OK != ksuid_GetTimestampFromKsuidObj(interp, objPtr, &timestamp)) {
+        return TCL_ERROR;
+    }
+
+    Tcl_WideInt value = timestamp;
+    if (optionsPtr->unix_time) {
+        value += DEFAULT_EPOCH;
+    }
+    *valuePtr = optionsPtr->millis ? value * 1000 + nanos / 1000000 : value;
+    return TCL_OK;
+}
+
+static int ksuid_TimestampCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "TimestampCmd\n"));
+    CheckArgs(2, 6, 1, "ksuid ?-unix? ?-millis? ?-precision precision?");
+
+    ksuid_timestamp_options_t options;
+    if (TCL_OK != ksuid_GetTimestampOptions(interp, objc, objv, &options)) {
+        return TCL_ERROR;
+    }
+
+    Tcl_WideInt value;
+    if (TCL_OK != ksuid_GetTimestampValue(interp, objv[1], &options, &value)) {
+        return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, Tcl_NewWideIntObj(value));
+    return TCL_OK;
+}
+
+static int ksuid_TimestampsCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "TimestampsCmd\n"));
+    CheckArgs(2, 6, 1, "list ?-unix? ?-millis? ?-precision precision?");
+
+    ksuid_timestamp_options_t options;
+    if (TCL_OK != ksuid_GetTimestampOptions(interp, objc, objv, &options)) {
+        return TCL_ERROR;
+    }
+
+    Tcl_Size count;
+    Tcl_Obj **elements;
+    if (TCL_OK != Tcl_ListObjGetElements(interp, objv[1], &count, &elements)) {
+        return TCL_ERROR;
+    }
+
+    std::vector<Tcl_WideInt> values(count);
+    for (Tcl_Size i = 0; i < count; i++) {
+        if (TCL_OK != ksuid_GetTimestampValue(interp, elements[i], &options, &values[i])) {
+            return TCL_ERROR;
+        }
+    }
+
+    std::vector<Tcl_Obj *> column(count);
+    for (Tcl_Size i = 0; i < count; i++) {
+        column[i] = Tcl_NewWideIntObj(values[i]);
+    }
+    Tcl_SetObjResult(interp, Tcl_NewListObj(count, column.data()));
+    return TCL_OK;
+}
+
+// ---- Validation ----
+// Checks the length, the alphabet and the upper bound of a ksuid without
+// decoding it and without changing the type of the value.
+
+static int ksuid_IsValidObj(Tcl_Obj *objPtr) {
+    if (objPtr->typePtr == &ksuid_ObjType) {
+        return 1;
+    }
+    Tcl_Size length;
+    auto ksuid = (const unsigned char *) Tcl_GetStringFromObj(objPtr, &length);
+    return length == PAD_TO_LENGTH && TCL_OK == base62_validate(ksuid);
+}
+
+static int ksuid_IsValidCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "IsValidCmd\n"));
+    CheckArgs(2, 2, 1, "ksuid");
+
+    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(ksuid_IsValidObj(objv[1])));
+    return TCL_OK;
+}
+
+static int ksuid_ValidateManyCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "ValidateManyCmd\n"));
+    CheckArgs(2, 2, 1, "list");
+
+    Tcl_Size count;
+    Tcl_Obj **elements;
+    if (TCL_OK != Tcl_ListObjGetElements(interp, objv[1], &count, &elements)) {
+        return TCL_ERROR;
+    }
+
+    // the indexes of the invalid entries
+    Tcl_Obj *resultPtr = Tcl_NewListObj(0, nullptr);
+    for (Tcl_Size i = 0; i < count; i++) {
+        if (!ksuid_IsValidObj(elements[i])) {
+            Tcl_ListObjAppendElement(nullptr, resultPtr, Tcl_NewWideIntObj(i));
+        }
+    }
+    Tcl_SetObjResult(interp, resultPtr);
+    return TCL_OK;
+}
+
+// ---- Time ranges ----
+// Every ksuid of a second lies between the timestamp followed by sixteen zero
+// bytes and the timestamp followed by sixteen 0xff bytes, so the bounds of a
+// time window are built directly in binary form.
+
+static int ksuid_GetTimestampFromObj(Tcl_Interp *interp, Tcl_Obj *objPtr, int unix_time, unsigned int *timestampPtr) {
+    Tcl_WideInt value;
+    if (TCL_OK != Tcl_GetWideIntFromObj(interp, objPtr, &value)) {
+        return TCL_ERROR;
+    }
+    if (unix_time) {
+        value -= DEFAULT_EPOCH;
+    }
+    if (value < 0 || value > UINT32_MAX) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("timestamp out of range", -1));
+        return TCL_ERROR;
+    }
+    *timestampPtr = (unsigned int) value;
+    return TCL_OK;
+}
+
+static int ksuid_RangeBoundsCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "RangeBoundsCmd\n"));
+    CheckArgs(3, 4, 1, "t1 t2 ?-unix?");
+
+    int unix_time = 0;
+    if (objc == 4) {
+        static const char *options[] = {"-unix", nullptr};
+        int optionIndex;
+        if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[3], options, "option", 0, &optionIndex)) {
+            return TCL_ERROR;
+        }
+        unix_time = 1;
+    }
+
+    unsigned int first, last;
+    if (TCL_OK != ksuid_GetTimestampFromObj(interp, objv[1], unix_time, &first)
+        || TCL_OK != ksuid_GetTimestampFromObj(interp, objv[2], unix_time, &last)) {
+        return TCL_ERROR;
+    }
+    if (first > last) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("t1 must not be after t2", -1));
+        return TCL_ERROR;
+    }
+
+    unsigned char min_bytes[TOTAL_BYTES];
+    ksuid_TimestampToBytes(first, min_bytes);
+    memset(min_bytes + TIMESTAMP_BYTES, 0x00, PAYLOAD_BYTES);
+
+    unsigned char max_bytes[TOTAL_BYTES];
+    ksuid_TimestampToBytes(last, max_bytes);
+    memset(max_bytes + TIMESTAMP_BYTES, 0xFF, PAYLOAD_BYTES);
+
+    Tcl_Obj *bounds[2] = {ksuid_NewKsuidObj(min_bytes), ksuid_NewKsuidObj(max_bytes)};
+    Tcl_SetObjResult(interp, Tcl_NewListObj(2, bounds));
+    return TCL_OK;
+}
+
+static int ksuid_BucketCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "BucketCmd\n"));
+    CheckArgs(3, 3, 1, "ksuid granularity");
+
+    const unsigned char *ksuid_bytes;
+    if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[1], &ksuid_bytes)) {
+        return TCL_ERROR;
+    }
+    Tcl_WideInt timestamp = ksuid_BytesToTimestamp(ksuid_bytes);
+
+    Tcl_WideInt granularity;
+    if (TCL_OK != Tcl_GetWideIntFromObj(interp, objv[2], &granularity)) {
+        return TCL_ERROR;
+    }
+    if (granularity <= 0) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("granularity must be positive", -1));
+        return TCL_ERROR;
+    }
+
+    // windows are aligned to unix time, not to the ksuid epoch, so that e.g.
+    // hourly buckets start on the hour; a window that starts before the epoch
+    // is clamped to timestamp zero
+    Tcl_WideInt unix_time = timestamp + DEFAULT_EPOCH;
+    Tcl_WideInt start = unix_time - unix_time % granularity - DEFAULT_EPOCH;
+
+    unsigned char bucket_bytes[TOTAL_BYTES];
+    ksuid_TimestampToBytes(start < 0 ? 0 : (unsigned int) start, bucket_bytes);
+    memset(bucket_bytes + TIMESTAMP_BYTES, 0x00, PAYLOAD_BYTES);
+
+    Tcl_SetObjResult(interp, ksuid_NewKsuidObj(bucket_bytes));
+    return TCL_OK;
+}
+
+// ---- Scanning channels and files ----
+// Regular files are memory-mapped, everything else (channels, but also pipes,
+// devices and /proc files given with -file) is read in large blocks; scan.cc
+// finds the 27-character candidates and every candidate is validated with the
+// base62 decoder here. Without a callback all ksuids found are returned,
+// with one they are passed to it in batches.
+//
+// A mapped file that is truncated while it is being scanned raises SIGBUS,
+// as with any mmap reader. Files that may shrink under the scan are better
+// opened as a channel and passed to scan instead of -file.
+
+#define KSUID_SCAN_BLOCK_SIZE (1024 * 1024)
+#define KSUID_SCAN_BATCH_SIZE 1024
+
+typedef struct {
+    Tcl_Interp *interp;
+    Tcl_Obj *callbackPtr;
+    Tcl_Obj *batchPtr;
+    Tcl_WideInt count;
+    int filter;
+    unsigned int first;
+    unsigned int last;
+} ksuid_scan_t;
+
+static int ksuid_ScanFlush(ksuid_scan_t *scanPtr) {
+    Tcl_Obj *cmdPtr = Tcl_DuplicateObj(scanPtr->callbackPtr);
+    Tcl_IncrRefCount(cmdPtr);
+    int rc = Tcl_ListObjAppendElement(scanPtr->interp, cmdPtr, scanPtr->batchPtr);
+    Tcl_DecrRefCount(scanPtr->batchPtr);
+    scanPtr->batchPtr = Tcl_NewListObj(0, nullptr);
+    Tcl_IncrRefCount(scanPtr->batchPtr);
+    if (rc == TCL_OK) {
+        rc = Tcl_EvalObjEx(scanPtr->interp, cmdPtr, TCL_EVAL_GLOBAL);
+    }
+    Tcl_DecrRefCount(cmdPtr);
+    // break stops the scan, continue and return are the same as ok
+    return rc == TCL_ERROR || rc == TCL_BREAK ? rc : TCL_OK;
+}
+
+static int ksuid_ScanFound(void *clientData, const unsigned char candidate[SCAN_KSUID_LENGTH]) {
+    auto scanPtr = (ksuid_scan_t *) clientData;
+
+    unsigned char timestamp_and_payload_bytes[TOTAL_BYTES];
+    if (TCL_OK != base62_decode(candidate, timestamp_and_payload_bytes)) {
+        return TCL_OK;
+    }
+    if (scanPtr->filter) {
+        unsigned int timestamp = ksuid_BytesToTimestamp(timestamp_and_payload_bytes);
+        if (timestamp < scanPtr->first || timestamp > scanPtr->last) {
+            return TCL_OK;
+        }
+    }
+
+    Tcl_ListObjAppendElement(nullptr, scanPtr->batchPtr,
+                             ksuid_NewKsuidObjFromString(timestamp_and_payload_bytes, candidate));
+    scanPtr->count++;
+
+    if (scanPtr->callbackPtr != nullptr) {
+        Tcl_Size length;
+        Tcl_ListObjLength(nullptr, scanPtr->batchPtr, &length);
+        if (length >= KSUID_SCAN_BATCH_SIZE) {
+            return ksuid_ScanFlush(scanPtr);
+        }
+    }
+    return TCL_OK;
+}
+
+static int ksuid_ScanChannel(Tcl_Interp *interp, Tcl_Channel channel, scan_state_t *statePtr, ksuid_scan_t *scanPtr) {
+    std::vector<unsigned char> buffer(KSUID_SCAN_BLOCK_SIZE);
+    for (;;) {
+        // raw bytes, the channel encoding does not matter for ascii ksuids
+        Tcl_Size n = Tcl_Read(channel, (char *) buffer.data(), KSUID_SCAN_BLOCK_SIZE);
+        if (n < 0) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf("error reading \"%s\": %s", Tcl_GetChannelName(channel),
+                                                   Tcl_PosixError(interp)));
+            return TCL_ERROR;
+        }
+        if (n == 0) {
+            // end of file, or no data on a non-blocking channel
+            return TCL_OK;
+        }
+        int rc = scan_block(statePtr, buffer.data(), n, ksuid_ScanFound, scanPtr);
+        if (rc != TCL_OK) {
+            return rc;
+        }
+    }
+}
+
+static int ksuid_ScanFile(Tcl_Interp *interp, Tcl_Obj *pathPtr, scan_state_t *statePtr, ksuid_scan_t *scanPtr) {
+#ifndef _WIN32
+    auto path = (const char *) Tcl_FSGetNativePath(pathPtr);
+    int fd = path != nullptr ? open(path, O_RDONLY) : -1;
+    if (fd < 0) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("couldn't open \"%s\": %s", Tcl_GetString(pathPtr),
+                                               path != nullptr ? Tcl_PosixError(interp) : "invalid path"));
+        return TCL_ERROR;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("couldn't stat \"%s\": %s", Tcl_GetString(pathPtr),
+                                               Tcl_PosixError(interp)));
+        close(fd);
+        return TCL_ERROR;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        // the size of pipes and special files says nothing about their contents
+        Tcl_Channel channel = Tcl_MakeFileChannel((ClientData) (intptr_t) fd, TCL_READABLE);
+        Tcl_SetChannelOption(nullptr, channel, "-translation", "binary");
+        int rc = ksuid_ScanChannel(interp, channel, statePtr, scanPtr);
+        Tcl_Close(nullptr, channel);
+        return rc;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return TCL_OK;
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("couldn't map \"%s\": %s", Tcl_GetString(pathPtr),
+                                               Tcl_PosixError(interp)));
+        return TCL_ERROR;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    int rc = scan_block(statePtr, (const unsigned char *) data, st.st_size, ksuid_ScanFound, scanPtr);
+    munmap(data, st.st_size);
+    return rc;
+#else
+    Tcl_Channel channel = Tcl_FSOpenFileChannel(interp, pathPtr, "rb", 0);
+    if (channel == nullptr) {
+        return TCL_ERROR;
+    }
+    int rc = ksuid_ScanChannel(interp, channel, statePtr, scanPtr);
+    Tcl_Close(nullptr, channel);
+    return rc;
+#endif
+}
+
+static int ksuid_ScanCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "ScanCmd\n"));
+    const char *usage = "channel|-file path ?-callback command? ?-timerange t1 t2? ?-unix?";
+    CheckArgs(2, 9, 1, usage);
+
+    // ---- The source ----
+    Tcl_Obj *pathPtr = nullptr;
+    Tcl_Channel channel = nullptr;
+    int i = 2;
+    if (strcmp(Tcl_GetString(objv[1]), "-file") == 0) {
+        if (objc < 3) {
+            Tcl_WrongNumArgs(interp, 1, objv, usage);
+            return TCL_ERROR;
+        }
+        pathPtr = objv[2];
+        i = 3;
+    } else {
+        int mode;
+        channel = Tcl_GetChannel(interp, Tcl_GetString(objv[1]), &mode);
+        if (channel == nullptr) {
+            return TCL_ERROR;
+        }
+        if (!(mode & TCL_READABLE)) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf("channel \"%s\" wasn't opened for reading",
+                                                   Tcl_GetString(objv[1])));
+            return TCL_ERROR;
+        }
+    }
+
+    // ---- Options ----
+    Tcl_Obj *callbackPtr = nullptr;
+    Tcl_Obj *firstPtr = nullptr;
+    Tcl_Obj *lastPtr = nullptr;
+    int unix_time = 0;
+    static const char *options[] = {"-callback", "-timerange", "-unix", nullptr};
+    enum option {
+        OPTION_CALLBACK, OPTION_TIMERANGE, OPTION_UNIX
+    };
+    for (; i < objc; i++) {
+        int optionIndex;
+        if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, &optionIndex)) {
+            return TCL_ERROR;
+        }
+        switch ((enum option) optionIndex) {
+            case OPTION_CALLBACK:
+                if (i + 1 >= objc) {
+                    Tcl_WrongNumArgs(interp, 1, objv, usage);
+                    return TCL_ERROR;
+                }
+                callbackPtr = objv[++i];
+                break;
+            case OPTION_TIMERANGE:
+                if (i + 2 >= objc) {
+                    Tcl_WrongNumArgs(interp, 1, objv, usage);
+                    return TCL_ERROR;
+                }
+                firstPtr = objv[++i];
+                lastPtr = objv[++i];
+                break;
+            case OPTION_UNIX:
+                unix_time = 1;
+                break;
+        }
+    }
+
+    ksuid_scan_t scan = {interp, callbackPtr, nullptr, 0, 0, 0, 0};
+    if (firstPtr != nullptr) {
+        if (TCL_OK != ksuid_GetTimestampFromObj(interp, firstPtr, unix_time, &scan.first)
+            || TCL_OK != ksuid_GetTimestampFromObj(interp, lastPtr, unix_time, &scan.last)) {
+            return TCL_ERROR;
+        }
+        scan.filter = 1;
+    }
+
+    // ---- Scan ----
+    scan.batchPtr = Tcl_NewListObj(0, nullptr);
+    Tcl_IncrRefCount(scan.batchPtr);
+    scan_state_t state;
+    scan_init(&state);
+
+    int rc;
+    if (pathPtr != nullptr) {
+        rc = ksuid_ScanFile(interp, pathPtr, &state, &scan);
+    } else {
+        // keep the channel alive should the callback close it
+        Tcl_RegisterChannel(nullptr, channel);
+        rc = ksuid_ScanChannel(interp, channel, &state, &scan);
+        Tcl_UnregisterChannel(nullptr, channel);
+    }
+    if (rc == TCL_OK) {
+        rc = scan_finish(&state, ksuid_ScanFound, &scan);
+    }
+
+    Tcl_Size remaining;
+    Tcl_ListObjLength(nullptr, scan.batchPtr, &remaining);
+    if (rc == TCL_OK && callbackPtr != nullptr && remaining > 0) {
+        rc = ksuid_ScanFlush(&scan);
+    }
+    if (rc == TCL_ERROR) {
+        Tcl_DecrRefCount(scan.batchPtr);
+        return TCL_ERROR;
+    }
+
+    // a break from the callback ends the scan early but is not an error
+    if (callbackPtr != nullptr) {
+        Tcl_SetObjResult(interp, Tcl_NewWideIntObj(scan.count));
+    } else {
+        Tcl_SetObjResult(interp, scan.batchPtr);
+    }
+    Tcl_DecrRefCount(scan.batchPtr);
+    return TCL_OK;
+}
+
+// ---- Monotonic sequences ----
+// A sequence hands out strictly increasing ksuids: the first ksuid of every
+// second (or of every unit of its sub-second precision) gets a fresh random
+// payload, later ones within the same unit are the previous ksuid plus one.
+// The state lives in the command's client data, so it belongs to the interp
+// (and therefore the thread) that created it.
+
+typedef struct {
+    Tcl_Command token;
+    const ksuid_precision_t *precisionPtr;
+    int started;
+    unsigned char last[TOTAL_BYTES]; // the last ksuid handed out
+} ksuid_sequence_t;
+
+static void ksuid_SequenceDeleteProc(ClientData clientData) {
+    ckfree((char *) clientData);
+}
+
+static int ksuid_SequenceNext(Tcl_Interp *interp, ksuid_sequence_t *sequencePtr) {
+    auto precisionPtr = sequencePtr->precisionPtr;
+    auto tsdPtr = ksuid_GetThreadData();
+    unsigned char timestamp_bytes[TIMESTAMP_BYTES];
+    uint32_t nanos;
+    ksuid_CurrentTime(tsdPtr, DEFAULT_EPOCH, precisionPtr, timestamp_bytes, &nanos);
+    unsigned int timestamp = ksuid_BytesToTimestamp(timestamp_bytes);
+
+    // the current time and the time of the last ksuid, both in units of the precision
+    uint64_t now = ((uint64_t) timestamp << 32) | (nanos / precisionPtr->nanos_per_unit);
+    uint64_t last = ((uint64_t) ksuid_BytesToTimestamp(sequencePtr->last) << 32)
+                    | ksuid_FractionFromBytes(precisionPtr, sequencePtr->last + TIMESTAMP_BYTES);
+
+    if (!sequencePtr->started || now > last) {
+        if (TCL_OK != csprng_bytes(&tsdPtr->rng, sequencePtr->last + TIMESTAMP_BYTES, PAYLOAD_BYTES)) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj("failed to generate random payload", -1));
+            return TCL_ERROR;
+        }
+        ksuid_TimestampToBytes(timestamp, sequencePtr->last);
+        ksuid_FractionToBytes(precisionPtr, nanos, sequencePtr->last + TIMESTAMP_BYTES);
+        sequencePtr->started = 1;
+    } else {
+        // Same unit of time (or the clock went back): keep counting from the last ksuid
+        auto u = make_uint128_from_bytes(sequencePtr->last + TIMESTAMP_BYTES);
+        incr128(u);
+        if (u.lo == 0 && u.hi == 0) { // overflow
+            ksuid_TimestampToBytes(ksuid_BytesToTimestamp(sequencePtr->last) + 1, sequencePtr->last);
+        }
+        uint128_to_bytes(u, sequencePtr->last + TIMESTAMP_BYTES);
+    }
+
+    Tcl_SetObjResult(interp, ksuid_NewKsuidObj(sequencePtr->last));
+    return TCL_OK;
+}
+
+static int ksuid_SequenceObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "SequenceObjCmd\n"));
+    CheckArgs(2, 2, 1, "method");
+
+    static const char *methods[] = {"next", "destroy", nullptr};
+    enum method {
+        METHOD_NEXT, METHOD_DESTROY
+    };
+    int methodIndex;
+    if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[1], methods, "method", 0, &methodIndex)) {
+        return TCL_ERROR;
+    }
+
+    auto sequencePtr = (ksuid_sequence_t *) clientData;
+    switch ((enum method) methodIndex) {
+        case METHOD_NEXT:
+            return ksuid_SequenceNext(interp, sequencePtr);
+        case METHOD_DESTROY:
+            Tcl_DeleteCommandFromToken(interp, sequencePtr->token);
+            return TCL_OK;
+    }
+    return TCL_OK;
+}
+
+static int ksuid_SequenceCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "SequenceCmd\n"));
+    if (objc < 3 || objc % 2 == 0 || objc > 7) {
+        Tcl_WrongNumArgs(interp, 1, objv, "create name ?-seed ksuid? ?-precision precision?");
+        return TCL_ERROR;
+    }
+
+    static const char *subcommands[] = {"create", nullptr};
+    int subcommandIndex;
+    if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[1], subcommands, "subcommand", 0, &subcommandIndex)) {
+        return TCL_ERROR;
+    }
+
+    unsigned char seed[TOTAL_BYTES];
+    int seeded = 0;
+    const ksuid_precision_t *precisionPtr = &KSUID_PRECISIONS[0];
+    static const char *options[] = {"-precision", "-seed", nullptr};
+    enum option {
+        OPTION_PRECISION, OPTION_SEED
+    };
+    for (int i = 3; i < objc; i += 2) {
+        int optionIndex;
+        if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, &optionIndex)) {
+            return TCL_ERROR;
+        }
+        switch ((enum option) optionIndex) {
+            case OPTION_PRECISION:
+                if (TCL_OK != ksuid_GetPrecisionFromObj(interp, objv[i + 1], &precisionPtr)) {
+                    return TCL_ERROR;
+                }
+                break;
+            case OPTION_SEED:
+                const unsigned char *ksuid_bytes;
+                if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[i + 1], &ksuid_bytes)) {
+                    return TCL_ERROR;
+                }
+                memcpy(seed, ksuid_bytes, TOTAL_BYTES);
+                seeded = 1;
+                break;
+        }
+    }
+
+    auto sequencePtr = (ksuid_sequence_t *) ckalloc(sizeof(ksuid_sequence_t));
+    sequencePtr->precisionPtr = precisionPtr;
+    sequencePtr->started = seeded;
+    if (seeded) {
+        memcpy(sequencePtr->last, seed, TOTAL_BYTES);
+    }
+    sequencePtr->token = Tcl_CreateObjCommand(interp, Tcl_GetString(objv[2]), ksuid_SequenceObjCmd, sequencePtr,
+                                              ksuid_SequenceDeleteProc);
+
+    Tcl_SetObjResult(interp, objv[2]);
+    return TCL_OK;
+}
+
+// ---- Generators ----
+// A generator is an object command that captures an epoch and a precision
+// once, so applications with their own epoch (e.g. 2020-01-01) get the same
+// fixed-size encoding path as the default commands.
+
+typedef struct {
+    Tcl_Command token;
+    ksuid_interp_data_t *interpDataPtr;
+    ksuid_layout_t layout;
+} ksuid_generator_t;
+
+static void ksuid_GeneratorDeleteProc(ClientData clientData) {
+    ckfree((char *) clientData);
+}
+
+static int ksuid_GeneratorObjCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "GeneratorObjCmd\n"));
+    CheckArgs(2, 3, 1, "method ?arg?");
+
+    static const char *methods[] = {"destroy", "epoch", "generate", "ksuid_to_parts", nullptr};
+    enum method {
+        METHOD_DESTROY, METHOD_EPOCH, METHOD_GENERATE, METHOD_KSUID_TO_PARTS
+    };
+    int methodIndex;
+    if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[1], methods, "method", 0, &methodIndex)) {
+        return TCL_ERROR;
+    }
+
+    auto generatorPtr = (ksuid_generator_t *) clientData;
+    if (methodIndex == METHOD_KSUID_TO_PARTS) {
+        if (objc != 3) {
+            Tcl_WrongNumArgs(interp, 2, objv, "ksuid");
+            return TCL_ERROR;
+        }
+    } else if (objc != 2) {
+        Tcl_WrongNumArgs(interp, 2, objv, "");
+        return TCL_ERROR;
+    }
+
+    switch ((enum method) methodIndex) {
+        case METHOD_DESTROY:
+            Tcl_DeleteCommandFromToken(interp, generatorPtr->token);
+            return TCL_OK;
+        case METHOD_EPOCH:
+            Tcl_SetObjResult(interp, Tcl_NewWideIntObj(generatorPtr->layout.epoch));
+            return TCL_OK;
+        case METHOD_GENERATE:
+            return ksuid_Generate(interp, &generatorPtr->layout);
+        case METHOD_KSUID_TO_PARTS: {
+            const unsigned char *ksuid_bytes;
+            if (TCL_OK != ksuid_GetBytesFromObj(interp, objv[2], &ksuid_bytes)) {
+                return TCL_ERROR;
+            }
+            Tcl_Obj *dictPtr;
+            if (TCL_OK != ksuid_KsuidToParts(interp, generatorPtr->interpDataPtr, ksuid_bytes,
+                                             generatorPtr->layout.precisionPtr, &dictPtr)) {
+                return TCL_ERROR;
+            }
+            Tcl_SetObjResult(interp, dictPtr);
+            return TCL_OK;
+        }
+    }
+    return TCL_OK;
+}
+
+static int ksuid_GeneratorCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "GeneratorCmd\n"));
+    if (objc < 3 || objc % 2 == 0 || objc > 7) {
+        Tcl_WrongNumArgs(interp, 1, objv, "create name ?-epoch epoch? ?-precision precision?");
+        return TCL_ERROR;
+    }
+
+    static const char *subcommands[] = {"create", nullptr};
+    int subcommandIndex;
+    if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[1], subcommands, "subcommand", 0, &subcommandIndex)) {
+        return TCL_ERROR;
+    }
+
+    ksuid_layout_t layout = KSUID_DEFAULT_LAYOUT;
+    static const char *options[] = {"-epoch", "-precision", nullptr};
+    enum option {
+        OPTION_EPOCH, OPTION_PRECISION
+    };
+    for (int i = 3; i < objc; i += 2) {
+        int optionIndex;
+        if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, &optionIndex)) {
+            return TCL_ERROR;
+        }
+        switch ((enum option) optionIndex) {
+            case OPTION_EPOCH:
+                if (TCL_OK != Tcl_GetWideIntFromObj(interp, objv[i + 1], &layout.epoch)) {
+                    return TCL_ERROR;
+                }
+                // the 32-bit timestamp counts forward from the epoch
+                if (layout.epoch < 0 || layout.epoch > ksuid_CurrentUnixNanos() / 1000000000) {
+                    Tcl_SetObjResult(interp, Tcl_NewStringObj("epoch out of range", -1));
+                    return TCL_ERROR;
+                }
+                break;
+            case OPTION_PRECISION:
+                if (TCL_OK != ksuid_GetPrecisionFromObj(interp, objv[i + 1], &layout.precisionPtr)) {
+                    return TCL_ERROR;
+                }
+                break;
+        }
+    }
+
+    auto generatorPtr = (ksuid_generator_t *) ckalloc(sizeof(ksuid_generator_t));
+    generatorPtr->interpDataPtr = (ksuid_interp_data_t *) clientData;
+    generatorPtr->layout = layout;
+    generatorPtr->token = Tcl_CreateObjCommand(interp, Tcl_GetString(objv[2]), ksuid_GeneratorObjCmd, generatorPtr,
+                                               ksuid_GeneratorDeleteProc);
+
+    Tcl_SetObjResult(interp, objv[2]);
+    return TCL_OK;
+}
+
+// ---- Pre-generated pool ----
+// Opt-in: a helper thread keeps a process-wide ring of encoded ksuids of the
+// default layout, so that generate_ksuid on a request thread is a pop from
+// the ring instead of a draw from the random generator, which reseeds from
+// the kernel every now and then. See pool.cc.
+
+#define KSUID_POOL_MAX_SIZE (1024 * 1024)
+
+static_assert(POOL_KSUID_BYTES == TOTAL_BYTES && POOL_KSUID_LENGTH == PAD_TO_LENGTH,
+              "the pool entries must match the ksuid layout");
+
+// Seconds added to the clock of the helper thread, see ::ksuid::pool clockoffset
+static std::atomic<int> ksuid_PoolClockOffset(0);
+
+// Runs on the helper thread
+static uint32_t ksuid_PoolTimestamp() {
+    return (uint32_t) (ksuid_CoarseUnixNanos() / 1000000000 - DEFAULT_EPOCH
+                       + ksuid_PoolClockOffset.load(std::memory_order_relaxed));
+}
+
+// Runs on the helper thread
+static int ksuid_PoolFill(csprng_t *rng, pool_entry_t *entries, size_t count) {
+    unsigned char payloads[64 * PAYLOAD_BYTES];
+    while (count > 0) {
+        size_t n = count < 64 ? count : 64;
+        if (TCL_OK != csprng_bytes(rng, payloads, n * PAYLOAD_BYTES)) {
+            return TCL_ERROR;
+        }
+        uint32_t timestamp = ksuid_PoolTimestamp();
+        for (size_t i = 0; i < n; i++) {
+            entries[i].timestamp = timestamp;
+            ksuid_TimestampToBytes(timestamp, entries[i].bytes);
+            memcpy(entries[i].bytes + TIMESTAMP_BYTES, payloads + i * PAYLOAD_BYTES, PAYLOAD_BYTES);
+            base62_encode_ksuid(entries[i].bytes, entries[i].ksuid);
+        }
+        entries += n;
+        count -= n;
+    }
+    memset(payloads, 0, sizeof(payloads));
+    return TCL_OK;
+}
+
+static int ksuid_GetPoolSizeFromObj(Tcl_Interp *interp, Tcl_Obj *objPtr, const char *name, size_t *sizePtr) {
+    Tcl_WideInt value;
+    if (TCL_OK != Tcl_GetWideIntFromObj(interp, objPtr, &value)) {
+        return TCL_ERROR;
+    }
+    if (value < 0 || value > KSUID_POOL_MAX_SIZE) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("%s must be between 0 and %d", name, KSUID_POOL_MAX_SIZE));
+        return TCL_ERROR;
+    }
+    *sizePtr = (size_t) value;
+    return TCL_OK;
+}
+
+static int ksuid_PoolConfigure(Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    pool_stats_t stats;
+    pool_get_stats(&stats);
+
+    if (objc == 2) {
+        Tcl_Obj *resultPtr = Tcl_NewListObj(0, nullptr);
+        Tcl_ListObjAppendElement(interp, resultPtr, Tcl_NewStringObj("-size", -1));
+        Tcl_ListObjAppendElement(interp, resultPtr, Tcl_NewWideIntObj((Tcl_WideInt) stats.size));
+        Tcl_ListObjAppendElement(interp, resultPtr, Tcl_NewStringObj("-lowwater", -1));
+        Tcl_ListObjAppendElement(interp, resultPtr, Tcl_NewWideIntObj((Tcl_WideInt) stats.lowwater));
+        Tcl_SetObjResult(interp, resultPtr);
+        return TCL_OK;
+    }
+
+    size_t size = stats.size;
+    size_t lowwater = 0;
+    int lowwater_given = 0;
+    static const char *options[] = {"-lowwater", "-size", nullptr};
+    enum option {
+        OPTION_LOWWATER, OPTION_SIZE
+    };
+    for (int i = 2; i < objc; i += 2) {
+        int optionIndex;
+        if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, &optionIndex)) {
+            return TCL_ERROR;
+        }
+        if (i + 1 >= objc) {
+            Tcl_WrongNumArgs(interp, 2, objv, "?-size size? ?-lowwater lowwater?");
+            return TCL_ERROR;
+        }
+        switch ((enum option) optionIndex) {
+            case OPTION_LOWWATER:
+                if (TCL_OK != ksuid_GetPoolSizeFromObj(interp, objv[i + 1], "lowwater", &lowwater)) {
+                    return TCL_ERROR;
+                }
+                lowwater_given = 1;
+                break;
+            case OPTION_SIZE:
+                if (TCL_OK != ksuid_GetPoolSizeFromObj(interp, objv[i + 1], "size", &size)) {
+                    return TCL_ERROR;
+                }
+                break;
+        }
+    }
+    if (!lowwater_given) {
+        lowwater = size / 2;
+    }
+    if (lowwater > size) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("lowwater must not exceed size", -1));
+        return TCL_ERROR;
+    }
+
+    if (TCL_OK != pool_configure(size, lowwater)) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("failed to start the pool thread", -1));
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+static int ksuid_PoolStats(Tcl_Interp *interp) {
+    pool_stats_t stats;
+    pool_get_stats(&stats);
+
+    Tcl_Obj *dictPtr = Tcl_NewDictObj();
+    Tcl_DictObjPut(interp, dictPtr, Tcl_NewStringObj("size", -1), Tcl_NewWideIntObj((Tcl_WideInt) stats.size));
+    Tcl_DictObjPut(interp, dictPtr, Tcl_NewStringObj("lowwater", -1), Tcl_NewWideIntObj((Tcl_WideInt) stats.lowwater));
+    Tcl_DictObjPut(interp, dictPtr, Tcl_NewStringObj("available", -1), Tcl_NewWideIntObj((Tcl_WideInt) stats.available));
+    Tcl_DictObjPut(interp, dictPtr, Tcl_NewStringObj("hits", -1), Tcl_NewWideIntObj((Tcl_WideInt) stats.hits));
+    Tcl_DictObjPut(interp, dictPtr, Tcl_NewStringObj("misses", -1), Tcl_NewWideIntObj((Tcl_WideInt) stats.misses));
+    Tcl_DictObjPut(interp, dictPtr, Tcl_NewStringObj("discarded", -1), Tcl_NewWideIntObj((Tcl_WideInt) stats.discarded));
+    Tcl_DictObjPut(interp, dictPtr, Tcl_NewStringObj("freed", -1), Tcl_NewWideIntObj((Tcl_WideInt) stats.freed));
+    Tcl_SetObjResult(interp, dictPtr);
+    return TCL_OK;
+}
+
+static int ksuid_PoolCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "PoolCmd\n"));
+    CheckArgs(2, 6, 1, "method ?arg ...?");
+
+    static const char *methods[] = {"clockoffset", "configure", "stats", nullptr};
+    enum method {
+        METHOD_CLOCKOFFSET, METHOD_CONFIGURE, METHOD_STATS
+    };
+    int methodIndex;
+    if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[1], methods, "method", 0, &methodIndex)) {
+        return TCL_ERROR;
+    }
+    switch ((enum method) methodIndex) {
+        case METHOD_CLOCKOFFSET:
+            if (objc > 3) {
+                Tcl_WrongNumArgs(interp, 2, objv, "?seconds?");
+                return TCL_ERROR;
+            }
+            if (objc == 3) {
+                int seconds;
+                if (TCL_OK != Tcl_GetIntFromObj(interp, objv[2], &seconds)) {
+                    return TCL_ERROR;
+                }
+                ksuid_PoolClockOffset.store(seconds, std::memory_order_relaxed);
+            }
+            Tcl_SetObjResult(interp, Tcl_NewIntObj(ksuid_PoolClockOffset.load(std::memory_order_relaxed)));
+            return TCL_OK;
+        case METHOD_CONFIGURE:
+            if (objc % 2 != 0) {
+                Tcl_WrongNumArgs(interp, 2, objv, "?-size size? ?-lowwater lowwater?");
+                return TCL_ERROR;
+            }
+            return ksuid_PoolConfigure(interp, objc, objv);
+        case METHOD_STATS:
+            if (objc != 2) {
+                Tcl_WrongNumArgs(interp, 2, objv, "");
+                return TCL_ERROR;
+            }
+            return ksuid_PoolStats(interp);
+    }
+    return TCL_OK;
+}
+
+static int ksuid_HexEncodeCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "HexEncodeCmd\n"));
+    CheckArgs(2, 2, 1, "bytes");
+
+    Tcl_Size length;
+    auto bytes = Tcl_GetByteArrayFromObj(objv[1], &length);
+    if (length > TCL_SIZE_MAX / 2) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("input too large", -1));
+        return TCL_ERROR;
+    }
+
+    // Encode straight into the string representation of the result
+    Tcl_Obj *resultPtr = Tcl_NewObj();
+    Tcl_SetObjLength(resultPtr, length * 2);
+    hex_encode(bytes, length, Tcl_GetString(resultPtr));
+
+    Tcl_SetObjResult(interp, resultPtr);
+    return TCL_OK;
+}
+
+static int ksuid_HexDecodeCmd(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]) {
+    DBG(fprintf(stderr, "HexDecodeCmd\n"));
+    if (objc < 2 || objc % 2 != 0 || objc > 6) {
+        Tcl_WrongNumArgs(interp, 1, objv, "hex_string ?-offset offset? ?-length length?");
+        return TCL_ERROR;
+    }
+
+    Tcl_Size length;
+    auto hex = Tcl_GetStringFromObj(objv[1], &length);
+
+    // ---- Optional window into the hex string ----
+    Tcl_Size offset = 0;
+    Tcl_Size window_length = -1;
+    static const char *options[] = {"-length", "-offset", nullptr};
+    enum option {
+        OPTION_LENGTH, OPTION_OFFSET
+    };
+    for (int i = 2; i < objc; i += 2) {
+        int optionIndex;
+        if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, &optionIndex)) {
+            return TCL_ERROR;
+        }
+        Tcl_Size value;
+        if (TCL_OK != Tcl_GetSizeIntFromObj(interp, objv[i + 1], &value)) {
+            return TCL_ERROR;
+        }
+        if (value < 0) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj("offset and length must be non-negative", -1));
+            return TCL_ERROR;
+        }
+        switch ((enum option) optionIndex) {
+            case OPTION_LENGTH:
+                window_length = value;
+                break;
+            case OPTION_OFFSET:
+                offset = value;
+                break;
+        }
+    }
+    if (offset > length) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("offset out of range", -1));
+        return TCL_ERROR;
+    }
+    if (window_length < 0) {
+        window_length = length - offset;
+    } else if (window_length > length - offset) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("length out of range", -1));
+        return TCL_ERROR;
+    }
+
+    if (window_length % 2 != 0) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid hex", -1));
+        return TCL_ERROR;
+    }
+
+    // ---- Decode straight into the storage of the result ----
+    Tcl_Obj *resultPtr = Tcl_NewByteArrayObj(nullptr, 0);
+    auto bytes = Tcl_SetByteArrayLength(resultPtr, window_length / 2);
+    if (TCL_OK != hex_decode(hex + offset, window_length, bytes)) {
+        Tcl_DecrRefCount(resultPtr);
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid hex", -1));
+        return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, resultPtr);
+    return TCL_OK;
+}
+
+static void ksuid_ExitHandler(ClientData unused) {
+    pool_shutdown();
+    Tcl_MutexLock(&ksuid_ModuleMutex);
+    ksuid_ModuleInitialized = 0;
+    Tcl_MutexUnlock(&ksuid_ModuleMutex);
+    Tcl_MutexFinalize(&ksuid_ModuleMutex);
+}
+
+void ksuid_InitModule() {
+    Tcl_MutexLock(&ksuid_ModuleMutex);
+    if (!ksuid_ModuleInitialized) {
+        csprng_init();
+        Tcl_RegisterObjType(&ksuid_ObjType);
+#if TCL_MAJOR_VERSION < 9
+        ksuid_ByteArrayObjType = Tcl_GetObjType("bytearray");
+#endif
+        pool_init(ksuid_PoolTimestamp, ksuid_PoolFill);
+        Tcl_CreateExitHandler(ksuid_ExitHandler, nullptr);
+        ksuid_ModuleInitialized = 1;
+    }
+    Tcl_MutexUnlock(&ksuid_ModuleMutex);
+}
+
+static void ksuid_DeleteInterpData(ClientData clientData, Tcl_Interp *interp) {
+    auto interpDataPtr = (ksuid_interp_data_t *) clientData;
+    Tcl_DecrRefCount(interpDataPtr->timestampKeyPtr);
+    Tcl_DecrRefCount(interpDataPtr->payloadKeyPtr);
+    for (auto keyPtr : interpDataPtr->precisionKeyPtrs) {
+        Tcl_DecrRefCount(keyPtr);
+    }
+    ckfree((char *) interpDataPtr);
+}
+
+static ksuid_interp_data_t *ksuid_GetInterpData(Tcl_Interp *interp) {
+    auto interpDataPtr = (ksuid_interp_data_t *) Tcl_GetAssocData(interp, KSUID_ASSOC_DATA_KEY, nullptr);
+    if (interpDataPtr == nullptr) {
+        interpDataPtr = (ksuid_interp_data_t *) ckalloc(sizeof(ksuid_interp_data_t));
+        interpDataPtr->timestampKeyPtr = Tcl_NewStringObj("timestamp", -1);
+        Tcl_IncrRefCount(interpDataPtr->timestampKeyPtr);
+        interpDataPtr->payloadKeyPtr = Tcl_NewStringObj("payload", -1);
+        Tcl_IncrRefCount(interpDataPtr->payloadKeyPtr);
+        for (int i = 0; KSUID_PRECISIONS[i].name != nullptr; i++) {
+            interpDataPtr->precisionKeyPtrs[i] = Tcl_NewStringObj(KSUID_PRECISIONS[i].name, -1);
+            Tcl_IncrRefCount(interpDataPtr->precisionKeyPtrs[i]);
+        }
+        Tcl_SetAssocData(interp, KSUID_ASSOC_DATA_KEY, ksuid_DeleteInterpData, interpDataPtr);
     }
+    return interpDataPtr;
 }
 
 int Ksuid_Init(Tcl_Interp *interp) {
@@ -416,13 +2380,34 @@ int Ksuid_Init(Tcl_Interp *interp) {
     }
 
     ksuid_InitModule();
+    auto interpDataPtr = ksuid_GetInterpData(interp);
 
     Tcl_CreateNamespace(interp, "::ksuid", nullptr, nullptr);
     Tcl_CreateObjCommand(interp, "::ksuid::generate_ksuid", ksuid_GenerateKsuidCmd, nullptr, nullptr);
-    Tcl_CreateObjCommand(interp, "::ksuid::ksuid_to_parts", ksuid_KsuidToPartsCmd, nullptr, nullptr);
-    Tcl_CreateObjCommand(interp, "::ksuid::parts_to_ksuid", ksuid_PartsToKsuidCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::generate_many", ksuid_GenerateManyCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::ksuid_to_parts", ksuid_KsuidToPartsCmd, interpDataPtr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::parts_many", ksuid_PartsManyCmd, interpDataPtr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::parts_to_ksuid", ksuid_PartsToKsuidCmd, interpDataPtr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::generate_binary", ksuid_GenerateBinaryCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::encode_binary", ksuid_EncodeBinaryCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::decode_binary", ksuid_DecodeBinaryCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::timestamp", ksuid_TimestampCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::timestamps", ksuid_TimestampsCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::is_valid", ksuid_IsValidCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::validate_many", ksuid_ValidateManyCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::scan", ksuid_ScanCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::range_bounds", ksuid_RangeBoundsCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::bucket", ksuid_BucketCmd, nullptr, nullptr);
     Tcl_CreateObjCommand(interp, "::ksuid::next_ksuid", ksuid_NextKsuidCmd, nullptr, nullptr);
     Tcl_CreateObjCommand(interp, "::ksuid::prev_ksuid", ksuid_PrevKsuidCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::add", ksuid_AddCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::diff", ksuid_DiffCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::split", ksuid_SplitCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::compare", ksuid_CompareCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::sort", ksuid_SortCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::sequence", ksuid_SequenceCmd, nullptr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::generator", ksuid_GeneratorCmd, interpDataPtr, nullptr);
+    Tcl_CreateObjCommand(interp, "::ksuid::pool", ksuid_PoolCmd, nullptr, nullptr);
     Tcl_CreateObjCommand(interp, "::ksuid::hex_encode", ksuid_HexEncodeCmd, nullptr, nullptr);
     Tcl_CreateObjCommand(interp, "::ksuid::hex_decode", ksuid_HexDecodeCmd, nullptr, nullptr);
 
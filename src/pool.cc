@@ -0,0 +1,483 @@
+#include <atomic>
+#include <cstring>
+#include <new>
+#include "pool.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+// A process-wide pool of pre-generated ksuids. A helper thread keeps a
+// bounded ring (Vyukov's queue, reduced to a single producer: the helper)
+// filled up to the configured size; request threads pop from it without
+// taking a lock and fall back to generating inline when it is empty. A
+// request thread that leaves the ring below the low water mark sets a flag,
+// which the helper polls along with the clock, so that it drops the entries
+// of the previous second soon after a second boundary.
+//
+// Every request thread owns a reader, which holds the ring the thread is
+// popping from (a hazard pointer) and the thread's counters. A pop only
+// writes to its own reader. A ring replaced by pool_configure is freed once
+// no reader holds it: a thread that arrives after the ring was unpublished
+// sees no ring at all, or sees it replaced and backs off.
+
+// ksuids generated per call of the fill proc
+#define POOL_FILL_BATCH 64
+
+// stale entries a request thread skips before giving up and generating inline
+#define POOL_MAX_STALE_POPS 4
+
+// how often the helper checks for refill requests and the next second
+#define POOL_POLL_USEC 1000
+
+#define POOL_CACHE_LINE 64
+
+typedef struct {
+    std::atomic<size_t> sequence;
+    pool_entry_t entry;
+} pool_cell_t;
+
+typedef struct pool_ring_t {
+    pool_cell_t *cells;
+    size_t mask;
+    size_t size;
+    size_t lowwater;
+    Tcl_ThreadId thread;
+    std::atomic<int> stop; // set under pool_mutex
+    uint32_t timestamp; // only used by the helper thread
+    csprng_t rng; // only used by the helper thread
+    char pad0[POOL_CACHE_LINE];
+    std::atomic<size_t> enqueue_pos;
+    char pad1[POOL_CACHE_LINE];
+    std::atomic<size_t> dequeue_pos;
+    char pad2[POOL_CACHE_LINE];
+    std::atomic<int> refill_requested;
+    char pad3[POOL_CACHE_LINE];
+} pool_ring_t;
+
+// Readers are never freed: the reader of an exited thread is handed to the
+// next new thread
+typedef struct pool_reader_t {
+    char pad0[POOL_CACHE_LINE];
+    std::atomic<pool_ring_t *> ring;
+    std::atomic<int> in_use;
+    // only written by the owning thread, folded into pool_exited when it exits
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> discarded;
+    struct pool_reader_t *next;
+    char pad1[POOL_CACHE_LINE];
+} pool_reader_t;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t discarded;
+} pool_counters_t;
+
+static std::atomic<pool_ring_t *> pool_active(nullptr);
+static std::atomic<pool_reader_t *> pool_readers(nullptr);
+static Tcl_ThreadDataKey pool_dataKey;
+
+// protected by pool_config_mutex
+static pool_counters_t pool_exited; // counters of the readers of exited threads
+static pool_counters_t pool_base; // counters at the last pool_configure
+static uint64_t pool_freed;
+
+// entries the helper dropped, only written by the helper thread
+static std::atomic<uint64_t> pool_helper_discarded(0);
+
+static pool_timestamp_proc *pool_timestamp = nullptr;
+static pool_fill_proc *pool_fill = nullptr;
+
+// serializes pool_configure and pool_shutdown
+TCL_DECLARE_MUTEX(pool_config_mutex)
+// protects the stop flag and the wakeups of the helper thread
+TCL_DECLARE_MUTEX(pool_mutex)
+static Tcl_Condition pool_cond;
+
+// ---- The ring ----
+
+static pool_ring_t *pool_NewRing(size_t size, size_t lowwater) {
+    size_t capacity = 2;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+
+    auto ring = new(std::nothrow) pool_ring_t;
+    if (ring == nullptr) {
+        return nullptr;
+    }
+    ring->cells = new(std::nothrow) pool_cell_t[capacity];
+    if (ring->cells == nullptr) {
+        delete ring;
+        return nullptr;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        ring->cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    ring->mask = capacity - 1;
+    ring->size = size;
+    ring->lowwater = lowwater;
+    ring->thread = nullptr;
+    ring->stop.store(0, std::memory_order_relaxed);
+    ring->timestamp = 0;
+    memset(&ring->rng, 0, sizeof(ring->rng));
+    ring->enqueue_pos.store(0, std::memory_order_relaxed);
+    ring->dequeue_pos.store(0, std::memory_order_relaxed);
+    ring->refill_requested.store(0, std::memory_order_relaxed);
+    return ring;
+}
+
+// Called with pool_config_mutex held
+static void pool_FreeRing(pool_ring_t *ring) {
+    csprng_destroy(&ring->rng);
+    delete[] ring->cells;
+    delete ring;
+    pool_freed++;
+}
+
+// Only called by the helper thread, so the enqueue position needs no CAS
+static int pool_RingPush(pool_ring_t *ring, const pool_entry_t *entry) {
+    size_t pos = ring->enqueue_pos.load(std::memory_order_relaxed);
+    pool_cell_t *cell = &ring->cells[pos & ring->mask];
+    if (cell->sequence.load(std::memory_order_acquire) != pos) {
+        return 0; // full, the consumer of the previous lap has not released the cell
+    }
+    cell->entry = *entry;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    ring->enqueue_pos.store(pos + 1, std::memory_order_relaxed);
+    return 1;
+}
+
+static int pool_RingPop(pool_ring_t *ring, pool_entry_t *entry) {
+    pool_cell_t *cell;
+    size_t pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+        cell = &ring->cells[pos & ring->mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+        if (diff == 0) {
+            if (ring->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0; // empty
+        } else {
+            pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    *entry = cell->entry;
+    cell->sequence.store(pos + ring->mask + 1, std::memory_order_release);
+    return 1;
+}
+
+// Only an estimate while other threads push or pop
+static size_t pool_RingLevel(pool_ring_t *ring) {
+    size_t enqueued = ring->enqueue_pos.load(std::memory_order_relaxed);
+    size_t dequeued = ring->dequeue_pos.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+// ---- The helper thread ----
+
+// Drops the entries of earlier seconds from the head of the ring. Entries
+// are pushed in time order, so this stops at the first current one, which
+// stays where it is. Only the helper writes entries, so it can read the
+// timestamp of the head before claiming the cell.
+static void pool_DrainStale(pool_ring_t *ring, uint32_t timestamp) {
+    size_t pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+        pool_cell_t *cell = &ring->cells[pos & ring->mask];
+        if (cell->sequence.load(std::memory_order_acquire) != pos + 1) {
+            return; // empty, or a consumer has just taken the head
+        }
+        if (cell->entry.timestamp == timestamp) {
+            return;
+        }
+        if (ring->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            cell->sequence.store(pos + ring->mask + 1, std::memory_order_release);
+            pool_helper_discarded.store(pool_helper_discarded.load(std::memory_order_relaxed) + 1,
+                                        std::memory_order_relaxed);
+            pos++;
+        }
+    }
+}
+
+static void pool_Refill(pool_ring_t *ring) {
+    pool_entry_t batch[POOL_FILL_BATCH];
+    // a large pool takes a while to fill, pool_configure must not wait for it
+    while (!ring->stop.load(std::memory_order_relaxed)) {
+        size_t level = pool_RingLevel(ring);
+        if (level >= ring->size) {
+            return;
+        }
+        size_t count = ring->size - level < POOL_FILL_BATCH ? ring->size - level : POOL_FILL_BATCH;
+        if (TCL_OK != pool_fill(&ring->rng, batch, count)) {
+            // request threads generate inline (and report the error) instead
+            return;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (!pool_RingPush(ring, &batch[i])) {
+                return;
+            }
+        }
+    }
+}
+
+static Tcl_ThreadCreateType pool_HelperThread(ClientData clientData) {
+    auto ring = (pool_ring_t *) clientData;
+
+    Tcl_MutexLock(&pool_mutex);
+    while (!ring->stop.load()) {
+        Tcl_MutexUnlock(&pool_mutex);
+        uint32_t timestamp = pool_timestamp();
+        // the first pass fills the new ring, a new second drops the old entries
+        int refill = ring->refill_requested.exchange(0, std::memory_order_relaxed);
+        if (timestamp != ring->timestamp) {
+            pool_DrainStale(ring, timestamp);
+            ring->timestamp = timestamp;
+            refill = 1;
+        }
+        if (refill) {
+            pool_Refill(ring);
+        }
+        Tcl_MutexLock(&pool_mutex);
+
+        if (!ring->stop.load()) {
+            Tcl_Time timeout = {0, POOL_POLL_USEC};
+            Tcl_ConditionWait(&pool_cond, &pool_mutex, &timeout);
+        }
+    }
+    Tcl_MutexUnlock(&pool_mutex);
+
+    TCL_THREAD_CREATE_RETURN;
+}
+
+// ---- Readers ----
+
+static void pool_ReleaseReader(ClientData clientData) {
+    auto reader = (pool_reader_t *) clientData;
+    Tcl_MutexLock(&pool_config_mutex);
+    pool_exited.hits += reader->hits.load(std::memory_order_relaxed);
+    pool_exited.misses += reader->misses.load(std::memory_order_relaxed);
+    pool_exited.discarded += reader->discarded.load(std::memory_order_relaxed);
+    reader->hits.store(0, std::memory_order_relaxed);
+    reader->misses.store(0, std::memory_order_relaxed);
+    reader->discarded.store(0, std::memory_order_relaxed);
+    reader->in_use.store(0, std::memory_order_release);
+    Tcl_MutexUnlock(&pool_config_mutex);
+}
+
+// Returns the reader of the calling thread, null if none could be allocated
+static pool_reader_t *pool_GetReader() {
+    auto readerPtr = (pool_reader_t **) Tcl_GetThreadData(&pool_dataKey, sizeof(pool_reader_t *));
+    if (*readerPtr != nullptr) {
+        return *readerPtr;
+    }
+
+    pool_reader_t *reader;
+    for (reader = pool_readers.load(std::memory_order_acquire); reader != nullptr; reader = reader->next) {
+        int expected = 0;
+        if (reader->in_use.load(std::memory_order_relaxed) == 0
+            && reader->in_use.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+            break;
+        }
+    }
+    if (reader == nullptr) {
+        reader = new(std::nothrow) pool_reader_t;
+        if (reader == nullptr) {
+            return nullptr;
+        }
+        reader->ring.store(nullptr, std::memory_order_relaxed);
+        reader->in_use.store(1, std::memory_order_relaxed);
+        reader->hits.store(0, std::memory_order_relaxed);
+        reader->misses.store(0, std::memory_order_relaxed);
+        reader->discarded.store(0, std::memory_order_relaxed);
+        reader->next = pool_readers.load(std::memory_order_relaxed);
+        while (!pool_readers.compare_exchange_weak(reader->next, reader, std::memory_order_release,
+                                                   std::memory_order_relaxed)) {
+        }
+    }
+    Tcl_CreateThreadExitHandler(pool_ReleaseReader, reader);
+    *readerPtr = reader;
+    return reader;
+}
+
+static void pool_AddCount(std::atomic<uint64_t> *counter) {
+    counter->store(counter->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// Called with pool_config_mutex held
+static void pool_SumCounters(pool_counters_t *counters) {
+    *counters = pool_exited;
+    for (pool_reader_t *reader = pool_readers.load(std::memory_order_acquire); reader != nullptr;
+         reader = reader->next) {
+        counters->hits += reader->hits.load(std::memory_order_relaxed);
+        counters->misses += reader->misses.load(std::memory_order_relaxed);
+        counters->discarded += reader->discarded.load(std::memory_order_relaxed);
+    }
+    counters->discarded += pool_helper_discarded.load(std::memory_order_relaxed);
+}
+
+// ---- Configuration ----
+
+// Called with pool_config_mutex held
+static void pool_Stop() {
+    pool_ring_t *ring = pool_active.exchange(nullptr);
+    if (ring == nullptr) {
+        return;
+    }
+
+    Tcl_MutexLock(&pool_mutex);
+    ring->stop.store(1);
+    Tcl_ConditionNotify(&pool_cond);
+    Tcl_MutexUnlock(&pool_mutex);
+
+    int result;
+    Tcl_JoinThread(ring->thread, &result);
+
+    // a reader only holds the ring for the duration of one pop, and no new
+    // pop can take it any more
+    for (pool_reader_t *reader = pool_readers.load(std::memory_order_acquire); reader != nullptr;
+         reader = reader->next) {
+        while (reader->ring.load() == ring) {
+            Tcl_Sleep(0);
+        }
+    }
+    pool_FreeRing(ring);
+}
+
+#ifndef _WIN32
+static void pool_AtForkPrepare() {
+    Tcl_MutexLock(&pool_config_mutex);
+    Tcl_MutexLock(&pool_mutex);
+}
+
+static void pool_AtForkParent() {
+    Tcl_MutexUnlock(&pool_mutex);
+    Tcl_MutexUnlock(&pool_config_mutex);
+}
+
+// The helper thread does not exist in the child, and the entries it made
+// must not be handed out twice, so the child starts without a pool. No other
+// thread exists either, so the ring can be freed right away.
+static void pool_AtForkChild() {
+    pool_ring_t *ring = pool_active.exchange(nullptr);
+    if (ring != nullptr) {
+        pool_FreeRing(ring);
+    }
+    // readers of threads that were in the middle of a pop still hold the ring
+    for (pool_reader_t *reader = pool_readers.load(); reader != nullptr; reader = reader->next) {
+        reader->ring.store(nullptr);
+    }
+    pool_SumCounters(&pool_base);
+    Tcl_MutexUnlock(&pool_mutex);
+    Tcl_MutexUnlock(&pool_config_mutex);
+}
+#endif
+
+void pool_init(pool_timestamp_proc *timestamp, pool_fill_proc *fill) {
+    static int initialized = 0;
+    Tcl_MutexLock(&pool_config_mutex);
+    pool_timestamp = timestamp;
+    pool_fill = fill;
+    if (!initialized) {
+#ifndef _WIN32
+        pthread_atfork(pool_AtForkPrepare, pool_AtForkParent, pool_AtForkChild);
+#endif
+        initialized = 1;
+    }
+    Tcl_MutexUnlock(&pool_config_mutex);
+}
+
+// A size of zero stops the pool
+int pool_configure(size_t size, size_t lowwater) {
+    Tcl_MutexLock(&pool_config_mutex);
+    pool_Stop();
+    pool_SumCounters(&pool_base);
+
+    int rc = TCL_OK;
+    if (size > 0) {
+        pool_ring_t *ring = pool_NewRing(size, lowwater);
+        if (ring == nullptr) {
+            rc = TCL_ERROR;
+        } else if (TCL_OK != Tcl_CreateThread(&ring->thread, pool_HelperThread, ring, TCL_THREAD_STACK_DEFAULT,
+                                       TCL_THREAD_JOINABLE)) {
+            pool_FreeRing(ring);
+            rc = TCL_ERROR;
+        } else {
+            pool_active.store(ring);
+        }
+    }
+    Tcl_MutexUnlock(&pool_config_mutex);
+    return rc;
+}
+
+// Returns TCL_OK with an entry of the given timestamp, or TCL_ERROR when the
+// pool is disabled or has none
+int pool_pop(uint32_t timestamp, pool_entry_t *entry) {
+    pool_ring_t *ring = pool_active.load(std::memory_order_acquire);
+    if (ring == nullptr) {
+        return TCL_ERROR;
+    }
+    pool_reader_t *reader = pool_GetReader();
+    if (reader == nullptr) {
+        return TCL_ERROR;
+    }
+
+    // publish the ring before using it, then make sure it was not replaced
+    // in between, see pool_Stop
+    reader->ring.store(ring);
+    if (pool_active.load() != ring) {
+        reader->ring.store(nullptr, std::memory_order_release);
+        return TCL_ERROR;
+    }
+
+    int rc = TCL_ERROR;
+    for (int i = 0; i < POOL_MAX_STALE_POPS; i++) {
+        if (!pool_RingPop(ring, entry)) {
+            break;
+        }
+        if (entry->timestamp == timestamp) {
+            rc = TCL_OK;
+            break;
+        }
+        pool_AddCount(&reader->discarded);
+    }
+
+    if (rc == TCL_OK) {
+        pool_AddCount(&reader->hits);
+    } else {
+        pool_AddCount(&reader->misses);
+    }
+    if ((rc != TCL_OK || pool_RingLevel(ring) < ring->lowwater)
+        && !ring->refill_requested.load(std::memory_order_relaxed)) {
+        ring->refill_requested.store(1, std::memory_order_relaxed);
+    }
+    reader->ring.store(nullptr, std::memory_order_release);
+    return rc;
+}
+
+void pool_get_stats(pool_stats_t *stats) {
+    Tcl_MutexLock(&pool_config_mutex);
+    pool_ring_t *ring = pool_active.load();
+    stats->size = ring != nullptr ? ring->size : 0;
+    stats->lowwater = ring != nullptr ? ring->lowwater : 0;
+    stats->available = ring != nullptr ? pool_RingLevel(ring) : 0;
+    pool_counters_t counters;
+    pool_SumCounters(&counters);
+    stats->hits = counters.hits - pool_base.hits;
+    stats->misses = counters.misses - pool_base.misses;
+    stats->discarded = counters.discarded - pool_base.discarded;
+    stats->freed = pool_freed;
+    Tcl_MutexUnlock(&pool_config_mutex);
+}
+
+// Stops the helper thread and frees the ring, called when the process exits
+void pool_shutdown() {
+    Tcl_MutexLock(&pool_config_mutex);
+    pool_Stop();
+    Tcl_MutexUnlock(&pool_config_mutex);
+    Tcl_ConditionFinalize(&pool_cond);
+}
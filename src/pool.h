@@ -0,0 +1,37 @@
+#ifndef KSUID_TCL_POOL_H
+#define KSUID_TCL_POOL_H
+
+#include <tcl.h>
+#include <cstddef>
+#include <cstdint>
+#include "csprng.h"
+
+#define POOL_KSUID_BYTES 20
+#define POOL_KSUID_LENGTH 27
+
+typedef struct {
+    uint32_t timestamp;
+    unsigned char bytes[POOL_KSUID_BYTES];
+    unsigned char ksuid[POOL_KSUID_LENGTH];
+} pool_entry_t;
+
+typedef struct {
+    size_t size;
+    size_t lowwater;
+    size_t available;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t discarded;
+    uint64_t freed; // rings freed since the module was loaded
+} pool_stats_t;
+
+typedef uint32_t (pool_timestamp_proc)();
+typedef int (pool_fill_proc)(csprng_t *rng, pool_entry_t *entries, size_t count);
+
+void pool_init(pool_timestamp_proc *timestamp, pool_fill_proc *fill);
+int pool_configure(size_t size, size_t lowwater);
+int pool_pop(uint32_t timestamp, pool_entry_t *entry);
+void pool_get_stats(pool_stats_t *stats);
+void pool_shutdown();
+
+#endif //KSUID_TCL_POOL_H
@@ -0,0 +1,175 @@
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <tcl.h>
+#include "custom_uint128.h"
+#include "radix_sort.h"
+
+// Runs shorter than this are sorted by comparing their keys directly
+#define RADIX_SORT_INSERTION_THRESHOLD 32
+
+// The keys are not moved around. Each entry carries 32 bits of its key and
+// the index of the key, eight bytes in all: the first 32 bits that are not
+// the same in all keys (usually the leading timestamp bytes are). Random
+// payloads leave few ties in 32 bits. Runs of ties are sorted by the bits
+// that follow, short runs by comparing the rest of their keys.
+typedef struct {
+    uint32_t bits;
+    uint32_t index;
+} radix_sort_entry_t;
+
+#define RADIX_SORT_WINDOW_BYTES 8
+
+static const unsigned char *key_at(const unsigned char *keys, uint32_t index, int offset) {
+    return keys + (size_t) index * RADIX_SORT_KEY_BYTES + offset;
+}
+
+static int leading_zeros(uint64_t value) {
+    int zeros = 0;
+    for (uint64_t bit = (uint64_t) 1 << 63; bit != 0 && (value & bit) == 0; bit >>= 1) {
+        zeros++;
+    }
+    return zeros;
+}
+
+// Sorts a short run by the key bytes from offset on
+static void insertion_sort(const unsigned char *keys, radix_sort_entry_t *entries, size_t count, int offset) {
+    size_t length = RADIX_SORT_KEY_BYTES - offset;
+    for (size_t i = 1; i < count; i++) {
+        radix_sort_entry_t entry = entries[i];
+        const unsigned char *key = key_at(keys, entry.index, offset);
+        size_t j = i;
+        while (j > 0 && memcmp(key_at(keys, entries[j - 1].index, offset), key, length) > 0) {
+            entries[j] = entries[j - 1];
+            j--;
+        }
+        entries[j] = entry;
+    }
+}
+
+// Most significant digit first radix sort of the 32 bits, one byte per
+// level. The entries start out in entries and end up in scratch when
+// to_scratch is set; the two buffers swap roles on every level so that
+// nothing is copied back after a scatter. The first level is the only one
+// that goes over all entries, the buckets of the next ones fit in the cache.
+static void msd_radix_sort(radix_sort_entry_t *entries, radix_sort_entry_t *scratch, size_t count, int shift,
+                           int to_scratch) {
+    while (shift >= 0 && count >= RADIX_SORT_INSERTION_THRESHOLD) {
+        size_t counts[256] = {0};
+        for (size_t i = 0; i < count; i++) {
+            counts[(entries[i].bits >> shift) & 0xff]++;
+        }
+
+        // all entries share this byte, no need to move anything
+        if (counts[(entries[0].bits >> shift) & 0xff] == count) {
+            shift -= 8;
+            continue;
+        }
+
+        size_t offsets[256];
+        size_t offset = 0;
+        for (int b = 0; b < 256; b++) {
+            offsets[b] = offset;
+            offset += counts[b];
+        }
+        for (size_t i = 0; i < count; i++) {
+            scratch[offsets[(entries[i].bits >> shift) & 0xff]++] = entries[i];
+        }
+
+        size_t start = 0;
+        for (int b = 0; b < 256; b++) {
+            if (counts[b] > 0) {
+                msd_radix_sort(scratch + start, entries + start, counts[b], shift - 8, !to_scratch);
+            }
+            start += counts[b];
+        }
+        return;
+    }
+
+    for (size_t i = 1; i < count; i++) {
+        radix_sort_entry_t entry = entries[i];
+        size_t j = i;
+        while (j > 0 && entries[j - 1].bits > entry.bits) {
+            entries[j] = entries[j - 1];
+            j--;
+        }
+        entries[j] = entry;
+    }
+    if (to_scratch) {
+        memcpy(scratch, entries, count * sizeof(radix_sort_entry_t));
+    }
+}
+
+// Sorts the entries by the key bytes from offset on, all earlier bytes are
+// the same in all of them
+static void sort_range(const unsigned char *keys, radix_sort_entry_t *entries, radix_sort_entry_t *scratch,
+                       size_t count, int offset) {
+    if (count < RADIX_SORT_INSERTION_THRESHOLD) {
+        insertion_sort(keys, entries, count, offset);
+        return;
+    }
+
+    // ---- Find the first bit that is not the same in all keys ----
+    const int last_offset = RADIX_SORT_KEY_BYTES - RADIX_SORT_WINDOW_BYTES;
+    int skip;
+    for (;;) {
+        if (offset > last_offset) {
+            offset = last_offset;
+        }
+        uint64_t first = uint128_load_be64(key_at(keys, entries[0].index, offset));
+        uint64_t differing = 0;
+        for (size_t i = 1; i < count; i++) {
+            differing |= uint128_load_be64(key_at(keys, entries[i].index, offset)) ^ first;
+        }
+        if (differing != 0) {
+            skip = leading_zeros(differing);
+            break;
+        }
+        if (offset == last_offset) {
+            return; // all keys are equal
+        }
+        offset += RADIX_SORT_WINDOW_BYTES;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        entries[i].bits = (uint32_t) ((uint128_load_be64(key_at(keys, entries[i].index, offset)) << skip) >> 32);
+    }
+    msd_radix_sort(entries, scratch, count, 24, 0);
+
+    // ---- Sort runs of ties by the rest of their keys ----
+    // all whole bytes up to bit skip + 32 of the window are the same in a run
+    int rest = offset + (skip + 32 < 64 ? skip + 32 : 64) / 8;
+    if (rest >= RADIX_SORT_KEY_BYTES) {
+        return;
+    }
+    size_t run = 0;
+    for (size_t i = 1; i <= count; i++) {
+        if (i < count && entries[i].bits == entries[run].bits) {
+            continue;
+        }
+        if (i - run > 1) {
+            sort_range(keys, entries + run, scratch + run, i - run, rest);
+        }
+        run = i;
+    }
+}
+
+int radix_sort(const unsigned char *keys, size_t count, size_t *order) {
+    if (count > UINT32_MAX) {
+        return TCL_ERROR;
+    }
+    auto entries = new(std::nothrow) radix_sort_entry_t[2 * count + 1];
+    if (!entries) {
+        return TCL_ERROR;
+    }
+    for (size_t i = 0; i < count; i++) {
+        entries[i].index = (uint32_t) i;
+    }
+    sort_range(keys, entries, entries + count, count, 0);
+
+    for (size_t i = 0; i < count; i++) {
+        order[i] = entries[i].index;
+    }
+    delete[] entries;
+    return TCL_OK;
+}
@@ -0,0 +1,13 @@
+#ifndef KSUID_TCL_RADIX_SORT_H
+#define KSUID_TCL_RADIX_SORT_H
+
+#include <cstddef>
+
+#define RADIX_SORT_KEY_BYTES 20
+
+// Fills order with the indices 0..count-1 of the keys, stored back to back
+// RADIX_SORT_KEY_BYTES apart, in increasing key order. Equal keys keep their
+// original order. Returns TCL_ERROR when out of memory.
+int radix_sort(const unsigned char *keys, size_t count, size_t *order);
+
+#endif //KSUID_TCL_RADIX_SORT_H
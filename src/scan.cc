@@ -0,0 +1,115 @@
+#include <cstring>
+#include "scan.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SCAN_HAVE_X86_64 1
+#include <emmintrin.h>
+#endif
+
+// Finds ksuid candidates in a stream of bytes: maximal runs of exactly 27
+// alphanumeric characters, i.e. runs not preceded or followed by another
+// letter or digit. The input may arrive in blocks of any size, a run that
+// reaches the end of a block is carried over in the state. Whether the
+// candidate is a valid ksuid is left to the caller.
+
+static inline int scan_is_alnum(unsigned char c) {
+    return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+}
+
+#ifdef SCAN_HAVE_X86_64
+
+// Bit i is set if byte i of the 16 at p is alphanumeric. Bytes above 0x7F are
+// negative as signed chars and fall outside both ranges.
+static inline unsigned int scan_alnum_mask_sse2(const unsigned char *p) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    // setting bit 5 folds upper case onto lower case and nothing else onto a-z
+    __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(folded, _mm_set1_epi8('a' - 1)),
+                                   _mm_cmplt_epi8(folded, _mm_set1_epi8('z' + 1)));
+    return (unsigned int) _mm_movemask_epi8(_mm_or_si128(digit, letter));
+}
+
+#endif
+
+// Length of the run of alphanumeric characters at the start of p
+static size_t scan_alnum_prefix(const unsigned char *p, size_t length) {
+    size_t i = 0;
+#ifdef SCAN_HAVE_X86_64
+    while (i + 16 <= length) {
+        unsigned int mask = scan_alnum_mask_sse2(p + i);
+        if (mask != 0xFFFF) {
+            return i + __builtin_ctz(~mask);
+        }
+        i += 16;
+    }
+#endif
+    while (i < length && scan_is_alnum(p[i])) {
+        i++;
+    }
+    return i;
+}
+
+// Length of the run of other characters at the start of p
+static size_t scan_other_prefix(const unsigned char *p, size_t length) {
+    size_t i = 0;
+#ifdef SCAN_HAVE_X86_64
+    while (i + 16 <= length) {
+        unsigned int mask = scan_alnum_mask_sse2(p + i);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+#endif
+    while (i < length && !scan_is_alnum(p[i])) {
+        i++;
+    }
+    return i;
+}
+
+void scan_init(scan_state_t *state) {
+    state->run_length = 0;
+}
+
+int scan_block(scan_state_t *state, const unsigned char *data, size_t length, scan_found_proc *found, void *clientData) {
+    size_t i = 0;
+    while (i < length) {
+        size_t n = scan_alnum_prefix(data + i, length - i);
+        if (n > 0) {
+            // only the first 27 characters of a run are ever needed
+            if (state->run_length < SCAN_KSUID_LENGTH) {
+                size_t keep = SCAN_KSUID_LENGTH - state->run_length;
+                memcpy(state->run + state->run_length, data + i, n < keep ? n : keep);
+            }
+            state->run_length += n;
+            i += n;
+            if (i == length) {
+                // the run may continue in the next block
+                break;
+            }
+        }
+
+        // data[i] ends the run
+        if (state->run_length == SCAN_KSUID_LENGTH) {
+            int rc = found(clientData, state->run);
+            if (rc != TCL_OK) {
+                state->run_length = 0;
+                return rc;
+            }
+        }
+        state->run_length = 0;
+        i += scan_other_prefix(data + i, length - i);
+    }
+    return TCL_OK;
+}
+
+int scan_finish(scan_state_t *state, scan_found_proc *found, void *clientData) {
+    int rc = TCL_OK;
+    if (state->run_length == SCAN_KSUID_LENGTH) {
+        rc = found(clientData, state->run);
+    }
+    state->run_length = 0;
+    return rc;
+}
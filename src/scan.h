@@ -0,0 +1,20 @@
+#ifndef KSUID_TCL_SCAN_H
+#define KSUID_TCL_SCAN_H
+
+#include <tcl.h>
+#include <cstddef>
+
+#define SCAN_KSUID_LENGTH 27
+
+typedef struct {
+    size_t run_length;
+    unsigned char run[SCAN_KSUID_LENGTH];
+} scan_state_t;
+
+typedef int (scan_found_proc)(void *clientData, const unsigned char candidate[SCAN_KSUID_LENGTH]);
+
+void scan_init(scan_state_t *state);
+int scan_block(scan_state_t *state, const unsigned char *data, size_t length, scan_found_proc *found, void *clientData);
+int scan_finish(scan_state_t *state, scan_found_proc *found, void *clientData);
+
+#endif //KSUID_TCL_SCAN_H